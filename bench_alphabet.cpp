@@ -0,0 +1,134 @@
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "include/alphabet.hpp"
+#include "include/container.hpp"
+
+void help() {
+    std::cout << "Benchmark partial sum lookups through index alphabets.\n\n";
+    std::cout << "Usage: bench_alphabet file_name\n";
+    std::cout << "   file_name    Path to a block index container.\n\n";
+    std::cout << "Times convert + p_sum on the root partial sums of the index, with the\n"
+              << "alphabet owned by an index object and with the alphabet in global\n"
+              << "storage, as it was when alphabets were static.\n\n";
+    std::cout << "Example: bench_alphabet bwt.rlbwt" << std::endl;
+    exit(0);
+}
+
+typedef bbwt::alphabet<uint64_t> alphabet_type;
+
+// Root partial sums with the alphabet they are read with, laid out like in
+// block_rlbwt.
+class p_sums {
+   private:
+    alphabet_type::meta_type alpha_;
+    std::vector<uint8_t> data_;
+    uint64_t rows_;
+
+   public:
+    p_sums() : alpha_(), data_(), rows_(0) {}
+
+    void load(const std::string& path) {
+        bbwt::container c(path, bbwt::index_kind::block);
+        std::fstream in_file;
+        in_file.open(path, std::ios::binary | std::ios::in);
+        c.seek(in_file, bbwt::section::statics);
+        alpha_.load_statics(in_file);
+        const bbwt::section_entry& s = c.get(bbwt::section::p_sums);
+        data_.resize(s.size);
+        c.seek(in_file, bbwt::section::p_sums);
+        in_file.read(reinterpret_cast<char*>(data_.data()), s.size);
+        rows_ = s.size / alpha_.size();
+    }
+
+    uint64_t p_sum(uint64_t row, uint8_t c) const {
+        c = alpha_.convert(c);
+        return reinterpret_cast<const alphabet_type*>(data_.data() + alpha_.size() * row)
+            ->p_sum(c, alpha_);
+    }
+
+    uint64_t rows() const { return rows_; }
+    uint8_t revert(uint8_t c) const { return alpha_.revert(c); }
+    uint8_t convert(uint8_t c) const { return alpha_.convert(c); }
+};
+
+p_sums global_p_sums;
+
+template <class F>
+double time_calls(const std::vector<uint64_t>& rows, const std::vector<uint8_t>& chars,
+                  uint64_t& sum, F f) {
+    using std::chrono::duration_cast;
+    using std::chrono::high_resolution_clock;
+    using std::chrono::nanoseconds;
+    const uint32_t REPEATS = 16;
+    auto start = high_resolution_clock::now();
+    uint64_t res = 0;
+    for (uint32_t r = 0; r < REPEATS; r++) {
+        for (size_t q = 0; q < rows.size(); q++) {
+            res += f(rows[q], chars[q]);
+        }
+    }
+    auto end = high_resolution_clock::now();
+    sum = res;
+    return double(duration_cast<nanoseconds>(end - start).count()) / (REPEATS * rows.size());
+}
+
+int main(int argc, char const* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Input file is required\n" << std::endl;
+        help();
+    }
+    std::string path = argv[1];
+    global_p_sums.load(path);
+    std::unique_ptr<p_sums> instance = std::make_unique<p_sums>();
+    instance->load(path);
+
+    std::vector<uint8_t> symbols;
+    for (uint16_t c = 0; c < 256; c++) {
+        if (instance->convert(c) != 0 || instance->revert(0) == c) {
+            symbols.push_back(c);
+        }
+    }
+
+    const uint64_t QUERIES = uint64_t(1) << 20;
+    std::mt19937 mt(1337);
+    std::uniform_int_distribution<uint64_t> row_gen(0, instance->rows() - 1);
+    std::uniform_int_distribution<uint64_t> c_gen(0, symbols.size() - 1);
+    std::vector<uint64_t> rows;
+    std::vector<uint8_t> chars;
+    for (uint64_t q = 0; q < QUERIES; q++) {
+        rows.push_back(row_gen(mt));
+        chars.push_back(symbols[c_gen(mt)]);
+    }
+
+    const p_sums* index = instance.get();
+    double best_global = 1e9;
+    double best_instance = 1e9;
+    uint64_t global_sum = 0;
+    uint64_t instance_sum = 0;
+    for (uint32_t round = 0; round < 5; round++) {
+        double t = time_calls(rows, chars, global_sum, [](uint64_t row, uint8_t c) {
+            return global_p_sums.p_sum(row, c);
+        });
+        best_global = t < best_global ? t : best_global;
+        t = time_calls(rows, chars, instance_sum, [&](uint64_t row, uint8_t c) {
+            return index->p_sum(row, c);
+        });
+        best_instance = t < best_instance ? t : best_instance;
+    }
+    if (global_sum != instance_sum) {
+        std::cerr << "Results differ: " << global_sum << " <-> " << instance_sum << std::endl;
+        exit(1);
+    }
+
+    std::cerr << instance->rows() << " rows, " << symbols.size() << " symbols, "
+              << QUERIES << " queries" << std::endl;
+    std::cout << "global alphabet:   " << best_global << " ns per call\n"
+              << "instance alphabet: " << best_instance << " ns per call" << std::endl;
+}
@@ -7,12 +7,13 @@
 
 #include "include/reader.hpp"
 #include "include/types.hpp"
+#include "include/open_index.hpp"
 
 void help() {
     std::cout << "Benchmark RLBWT data structure.\n\n";
     std::cout << "Usage: bench_bwt file_name_a file_name_b sequence\n";
-    std::cout << "   file_name_a    Path to block rlbwt root element.\n";
-    std::cout << "   file_name_b    Path to run rlbwt root element.\n";
+    std::cout << "   file_name_a    Path to index to benchmark.\n";
+    std::cout << "   file_name_b    Path to index to check results against.\n";
     std::cout << "   sequence       Path to file containing query sequence.\n\n";
     std::cout << "Input files is required.\n"
               << "Statistics will be output to std::cerr and rank query results sto std::cout.\n\n";
@@ -20,53 +21,33 @@ void help() {
     exit(0);
 }
 
-int main(int argc, char const* argv[]) {
-    if (argc < 3) {
-        std::cerr << "Input files are required\n" << std::endl;
-        help();
+template <class legacy_type, class F>
+auto with_index(const std::string& path, F f) {
+    if (bbwt::container::is_container(path)) {
+        return bbwt::open_index(path).visit(f);
     }
-    std::string in_file_path_a = "";
-    std::string in_file_path_b = "";
-    std::string sequence_path = "";
-    for (int i = 1; i < argc; i++) {
-        if (in_file_path_a.size() == 0) {
-            in_file_path_a = argv[i];
-        } else if (in_file_path_b.size() == 0) {
-            in_file_path_b = argv[i];
-        } else {
-            sequence_path = argv[i];
-        }
-    }
-    if (in_file_path_a.size() == 0 || in_file_path_b.size() == 0 || sequence_path.size() == 0) {
-        std::cerr << "Input files are required\n" << std::endl;
-        help();
-    }
-    bbwt::two_byte<> bwt_a(in_file_path_a);
-    bbwt::run<> bwt_b(in_file_path_b);
-
-    std::cerr << "Testing " << in_file_path_a << " and " << in_file_path_b << " with " << sequence_path << std::endl;
+    legacy_type bwt(path);
+    return f(bwt);
+}
 
+template <class bwt_type>
+void bench(const bwt_type& bwt_a, const std::vector<uint64_t>& positions,
+           const std::vector<uint8_t>& chars, const std::vector<bool>& dense_flags,
+           const std::vector<uint64_t>& b_ranks) {
     using std::chrono::duration_cast;
     using std::chrono::high_resolution_clock;
     using std::chrono::nanoseconds;
 
-    uint64_t i;
-    uint8_t c;
-    bool dense;
-
-    std::fstream in_file;
-    in_file.open(sequence_path, std::ios::binary | std::ios::in);
     uint64_t total = 0;
     uint64_t min_idx = std::numeric_limits<uint64_t>::max();
     uint8_t p_char = '\0';
     uint64_t a_res = 0;
     uint64_t b_res = 0;
-    while (in_file.good()) {
-        in_file.read(reinterpret_cast<char*>(&i), sizeof(uint64_t));
-        in_file.read(reinterpret_cast<char*>(&c), sizeof(uint8_t));
-        in_file.read(reinterpret_cast<char*>(&dense), sizeof(bool));
+    for (size_t q = 0; q < positions.size(); q++) {
+        uint64_t i = positions[q];
+        uint8_t c = chars[q];
         uint64_t r_a = bwt_a.rank(i, c);
-        uint64_t r_b = bwt_b.rank(i, c);
+        uint64_t r_b = b_ranks[q];
         if (r_a != r_b) {
             if (i < min_idx) {
                 min_idx = i;
@@ -90,12 +71,10 @@ int main(int argc, char const* argv[]) {
     double nanos_sparse = 0;
     uint32_t count_sparse = 0;
 
-    in_file.close();
-    in_file.open(sequence_path, std::ios::binary | std::ios::in);
-    while (in_file.good()) {
-        in_file.read(reinterpret_cast<char*>(&i), sizeof(uint64_t));
-        in_file.read(reinterpret_cast<char*>(&c), sizeof(uint8_t));
-        in_file.read(reinterpret_cast<char*>(&dense), sizeof(bool));
+    for (size_t q = 0; q < positions.size(); q++) {
+        uint64_t i = positions[q];
+        uint8_t c = chars[q];
+        bool dense = dense_flags[q];
         std::cout << int(c) << "\t" << i << "\t" << dense << "\t";
         auto start = high_resolution_clock::now();
         uint64_t r_a = bwt_a.rank(i, c);
@@ -117,4 +96,110 @@ int main(int argc, char const* argv[]) {
     std::cerr << (nanos_dense + nanos_sparse) / (count_dense + count_sparse) << " mean query time\n" 
               << nanos_dense / (count_dense ? count_dense : 1) << " mean dense query time (" << count_dense << ")\n"
               << nanos_sparse / (count_sparse ? count_sparse : 1) << " mean sparse query time (" << count_sparse << ")" << std::endl;
-}
\ No newline at end of file
+
+    std::vector<uint64_t> scalar(positions.size());
+    std::vector<uint64_t> batch(positions.size());
+    auto start = high_resolution_clock::now();
+    for (size_t q = 0; q < positions.size(); q++) {
+        scalar[q] = bwt_a.rank(positions[q], chars[q]);
+    }
+    auto end = high_resolution_clock::now();
+    double nanos_scalar = duration_cast<nanoseconds>(end - start).count();
+    start = high_resolution_clock::now();
+    bwt_a.rank_batch(positions.data(), chars.data(), batch.data(), positions.size());
+    end = high_resolution_clock::now();
+    double nanos_batch = duration_cast<nanoseconds>(end - start).count();
+    for (size_t q = 0; q < positions.size(); q++) {
+        if (scalar[q] != batch[q]) {
+            std::cerr << "Problem with rank_batch(" << positions[q] << ", " << chars[q] << "): " << batch[q] << " <-> " << scalar[q] << std::endl;
+            exit(1);
+        }
+    }
+    uint64_t n = positions.size() ? positions.size() : 1;
+
+    // rank_all against one rank call per symbol.
+    uint16_t sigma = bwt_a.sigma();
+    std::vector<uint64_t> all(positions.size() * sigma);
+    std::vector<uint64_t> each(positions.size() * sigma);
+    start = high_resolution_clock::now();
+    for (size_t q = 0; q < positions.size(); q++) {
+        bwt_a.rank_all(positions[q], all.data() + q * sigma);
+    }
+    end = high_resolution_clock::now();
+    double nanos_all = duration_cast<nanoseconds>(end - start).count();
+    start = high_resolution_clock::now();
+    for (size_t q = 0; q < positions.size(); q++) {
+        for (uint16_t k = 0; k < sigma; k++) {
+            each[q * sigma + k] = bwt_a.rank(positions[q], bwt_a.symbol(k));
+        }
+    }
+    end = high_resolution_clock::now();
+    double nanos_each = duration_cast<nanoseconds>(end - start).count();
+    if (all != each) {
+        std::cerr << "Problem with rank_all" << std::endl;
+        exit(1);
+    }
+    std::cerr << nanos_all / n << " mean rank_all time\n"
+              << nanos_each / n << " mean time of " << sigma << " rank calls" << std::endl;
+
+    std::cerr << nanos_scalar / n << " mean query time in loop\n"
+              << nanos_batch / n << " mean query time with rank_batch" << std::endl;
+}
+
+int main(int argc, char const* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Input files are required\n" << std::endl;
+        help();
+    }
+    std::string in_file_path_a = "";
+    std::string in_file_path_b = "";
+    std::string sequence_path = "";
+    for (int i = 1; i < argc; i++) {
+        if (in_file_path_a.size() == 0) {
+            in_file_path_a = argv[i];
+        } else if (in_file_path_b.size() == 0) {
+            in_file_path_b = argv[i];
+        } else {
+            sequence_path = argv[i];
+        }
+    }
+    if (in_file_path_a.size() == 0 || in_file_path_b.size() == 0 || sequence_path.size() == 0) {
+        std::cerr << "Input files are required\n" << std::endl;
+        help();
+    }
+    std::cerr << "Testing " << in_file_path_a << " and " << in_file_path_b << " with " << sequence_path << std::endl;
+
+    std::vector<uint64_t> positions;
+    std::vector<uint8_t> chars;
+    std::vector<bool> dense_flags;
+    std::fstream in_file;
+    in_file.open(sequence_path, std::ios::binary | std::ios::in);
+    while (in_file.good()) {
+        uint64_t i;
+        uint8_t c;
+        bool dense;
+        in_file.read(reinterpret_cast<char*>(&i), sizeof(uint64_t));
+        in_file.read(reinterpret_cast<char*>(&c), sizeof(uint8_t));
+        in_file.read(reinterpret_cast<char*>(&dense), sizeof(bool));
+        if (in_file.gcount() == 0) {
+            break;
+        }
+        positions.push_back(i);
+        chars.push_back(c);
+        dense_flags.push_back(dense);
+    }
+    in_file.close();
+
+    std::vector<uint64_t> b_ranks = with_index<bbwt::run<>>(in_file_path_b, [&](const auto& bwt_b) {
+        std::vector<uint64_t> ranks(positions.size());
+        for (size_t q = 0; q < positions.size(); q++) {
+            ranks[q] = bwt_b.rank(positions[q], chars[q]);
+        }
+        return ranks;
+    });
+
+    with_index<bbwt::two_byte<>>(in_file_path_a, [&](const auto& bwt_a) {
+        bench(bwt_a, positions, chars, dense_flags, b_ranks);
+        return 0;
+    });
+}
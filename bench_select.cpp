@@ -0,0 +1,83 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "include/open_index.hpp"
+
+void help() {
+    std::cout << "Benchmark select queries on indexes of different types.\n\n";
+    std::cout << "Usage: bench_select file_name [file_name ...]\n";
+    std::cout << "   file_name    Path to an index container.\n\n";
+    std::cout << "Builds select(c, k) queries for uniformly random positions of the BWT\n"
+              << "and reports the mean select and rank times of each index, with its\n"
+              << "kind, block encoding and block size. Build the indexes from the same\n"
+              << "BWT with different make_bwt options to compare encodings and block\n"
+              << "sizes.\n\n";
+    std::cout << "Example: bench_select bwt.rlbwt bwt_v.rlbwt bwt_r.rlbwt" << std::endl;
+    exit(0);
+}
+
+template <class F>
+double time_calls(uint64_t queries, uint64_t& sum, F f) {
+    using std::chrono::duration_cast;
+    using std::chrono::high_resolution_clock;
+    using std::chrono::nanoseconds;
+    auto start = high_resolution_clock::now();
+    uint64_t res = 0;
+    for (uint64_t q = 0; q < queries; q++) {
+        res += f(q);
+    }
+    auto end = high_resolution_clock::now();
+    sum = res;
+    return double(duration_cast<nanoseconds>(end - start).count()) / queries;
+}
+
+int main(int argc, char const* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Input file is required\n" << std::endl;
+        help();
+    }
+    const uint64_t QUERIES = uint64_t(1) << 20;
+    std::cout << "file\tkind\tencoding\tblock size\tselect ns\trank ns" << std::endl;
+    for (int f = 1; f < argc; f++) {
+        std::string path = argv[f];
+        bbwt::container c(path);
+        bbwt::open_index(path).visit([&](const auto& bwt) {
+            std::mt19937 mt(1337);
+            std::uniform_int_distribution<uint64_t> pos_gen(0, bwt.size() - 1);
+            std::vector<uint64_t> pos(QUERIES);
+            std::vector<uint8_t> syms(QUERIES);
+            std::vector<uint64_t> ranks(QUERIES);
+            for (uint64_t q = 0; q < QUERIES; q++) {
+                pos[q] = pos_gen(mt);
+                auto r = bwt.inverse_select(pos[q]);
+                syms[q] = r.first;
+                ranks[q] = r.second;
+            }
+            uint64_t select_sum;
+            uint64_t rank_sum;
+            double select_ns = time_calls(QUERIES, select_sum, [&](uint64_t q) {
+                return bwt.select(syms[q], ranks[q]);
+            });
+            double rank_ns = time_calls(QUERIES, rank_sum, [&](uint64_t q) {
+                return bwt.rank(pos[q], syms[q]);
+            });
+            for (uint64_t q = 0; q < QUERIES; q++) {
+                if (bwt.select(syms[q], ranks[q]) != pos[q]) {
+                    std::cerr << path << ": select(" << syms[q] << ", " << ranks[q]
+                              << ") = " << bwt.select(syms[q], ranks[q]) << ", expected "
+                              << pos[q] << std::endl;
+                    exit(1);
+                }
+            }
+            std::cerr << path << ": " << bwt.size() << " symbols, checksums " << select_sum
+                      << " " << rank_sum << std::endl;
+            std::cout << path << "\t" << static_cast<uint32_t>(c.kind()) << "\t" << c.encoding()
+                      << "\t" << c.block_size() << "\t" << select_ns << "\t" << rank_ns
+                      << std::endl;
+        });
+    }
+}
@@ -5,9 +5,15 @@
 #include <vector>
 #include <random>
 #include <chrono>
+#include <limits>
+#include <string>
 
 #include "include/reader.hpp"
 #include "include/types.hpp"
+#include "include/open_index.hpp"
+#include "include/interval_cache.hpp"
+#include "include/locate.hpp"
+#include "include/mismatches.hpp"
 
 void help() {
     std::cout << "count matches in RLBWT data structure.\n\n";
@@ -15,21 +21,30 @@ void help() {
     std::cout << "   bwt_file   Path to block rlbwt element.\n";
     std::cout << "   patterns   Path to file containing patterns.\n";
     std::cout << "   p_len      Length of patterns.\n";
-    std::cout << "   -s         Block rlbwt is space optimized.\n";
-    std::cout << "   -c         Blocks contains a constant number of runs.\n";
+    std::cout << "   -s         Block rlbwt is space optimized. (Old two file indexes only.)\n";
+    std::cout << "   -c         Blocks contains a constant number of runs. (Old two file indexes only.)\n";
     std::cout << "   -t         Don't include query times in std::cout\n";
+    std::cout << "   -m         Memory map the index instead of reading it.\n";
+    std::cout << "   -p         Read the index with parallel threads.\n";
+    std::cout << "   -l         Read the index with parallel threads to huge pages.\n";
+    std::cout << "   -L         Compare query times with and without huge pages.\n";
+    std::cout << "   -b bytes   Page block data in on demand, keeping at most bytes in memory.\n";
+    std::cout << "   -B         Count all patterns together with interleaved searches.\n";
+    std::cout << "   -o         Locate patterns, timing per occurrence. (Needs make_bwt -l.)\n";
+    std::cout << "   -v         Verify index checksums before querying.\n";
+    std::cout << "   -C entries Count with a cache of entries suffix ranges.\n";
+    std::cout << "   -k k       Count occurrences with at most k mismatches. (All together with -B.)\n";
     std::cout << "Bwt and pattern files are required.\n\n";
     std::cout << "Example: count_matches bwt.bin Einstein.txt >> /dev/null" << std::endl;
     exit(0);
 }
 
 template <class bwt_type>
-std::pair<double, size_t> bench(const std::string& in_file_path, std::ifstream& patterns, bool o_t, double& bps, uint16_t p_len) {
+std::pair<double, size_t> bench(const bwt_type& bwt, std::ifstream& patterns, bool o_t, double& bps, uint16_t p_len) {
     using std::chrono::duration_cast;
     using std::chrono::high_resolution_clock;
     using std::chrono::nanoseconds;
 
-    bwt_type bwt(in_file_path);
     bps = 8 * double(bwt.bytes()) / bwt.size();
     double total = 0;
     std::string p(p_len, '\0');
@@ -50,6 +65,164 @@ std::pair<double, size_t> bench(const std::string& in_file_path, std::ifstream&
     return {total, i};
 }
 
+template <class bwt_type>
+std::pair<double, size_t> bench_many(const bwt_type& bwt, std::ifstream& patterns, double& bps, uint16_t p_len) {
+    using std::chrono::duration_cast;
+    using std::chrono::high_resolution_clock;
+    using std::chrono::nanoseconds;
+
+    bps = 8 * double(bwt.bytes()) / bwt.size();
+    std::vector<std::string> pats;
+    std::string p(p_len, '\0');
+    while (patterns.read(p.data(), p_len)) {
+        pats.push_back(p);
+    }
+    std::vector<uint64_t> counts(pats.size());
+    auto start = high_resolution_clock::now();
+    bwt.count_many(pats.data(), counts.data(), pats.size());
+    auto end = high_resolution_clock::now();
+    for (size_t i = 0; i < pats.size(); i++) {
+        std::cout << pats[i] << "\t" << counts[i] << std::endl;
+    }
+    return {double(duration_cast<nanoseconds>(end - start).count()), pats.size()};
+}
+
+template <class bwt_type>
+std::pair<double, size_t> bench_locate(const bwt_type& bwt, const std::string& path, std::ifstream& patterns,
+                                       bool o_t, double& bps, uint16_t p_len) {
+    using std::chrono::duration_cast;
+    using std::chrono::high_resolution_clock;
+    using std::chrono::nanoseconds;
+
+    bbwt::locator<bwt_type> loc(bwt, path);
+    bps = 8 * double(bwt.bytes() + loc.bytes()) / bwt.size();
+    double total = 0;
+    uint64_t occurrences = 0;
+    std::string p(p_len, '\0');
+    size_t i = 0;
+    while (patterns.read(p.data(), p_len)) {
+        auto start = high_resolution_clock::now();
+        std::vector<uint64_t> occ = loc.locate(p);
+        auto end = high_resolution_clock::now();
+        double time = duration_cast<nanoseconds>(end - start).count();
+        if (o_t) {
+            std::cout << p << "\t" << occ.size() << "\t" << time << std::endl;
+        } else {
+            std::cout << p << "\t" << occ.size() << std::endl;
+        }
+        total += time;
+        occurrences += occ.size();
+        i++;
+    }
+    std::cerr << "Locate time per occurrence: " << total / (occurrences ? occurrences : 1) << "ns ("
+              << occurrences << " occurrences)" << std::endl;
+    return {total, i};
+}
+
+template <class bwt_type>
+std::pair<double, size_t> bench_mismatches(const bwt_type& bwt, std::ifstream& patterns, uint16_t k, bool many,
+                                           bool o_t, double& bps, uint16_t p_len) {
+    using std::chrono::duration_cast;
+    using std::chrono::high_resolution_clock;
+    using std::chrono::nanoseconds;
+
+    bps = 8 * double(bwt.bytes()) / bwt.size();
+    std::vector<std::string> pats;
+    std::string p(p_len, '\0');
+    while (patterns.read(p.data(), p_len)) {
+        pats.push_back(p);
+    }
+    std::vector<uint64_t> counts(pats.size());
+    std::vector<double> times(pats.size(), 0);
+    double total = 0;
+    if (many) {
+        auto start = high_resolution_clock::now();
+        bbwt::count_mismatches_many(bwt, pats.data(), k, counts.data(), pats.size());
+        auto end = high_resolution_clock::now();
+        total = duration_cast<nanoseconds>(end - start).count();
+    } else {
+        for (size_t i = 0; i < pats.size(); i++) {
+            auto start = high_resolution_clock::now();
+            counts[i] = bbwt::count_mismatches(bwt, pats[i], k);
+            auto end = high_resolution_clock::now();
+            times[i] = duration_cast<nanoseconds>(end - start).count();
+            total += times[i];
+        }
+    }
+    for (size_t i = 0; i < pats.size(); i++) {
+        if (o_t && !many) {
+            std::cout << pats[i] << "\t" << counts[i] << "\t" << times[i] << std::endl;
+        } else {
+            std::cout << pats[i] << "\t" << counts[i] << std::endl;
+        }
+    }
+    return {total, pats.size()};
+}
+
+template <class bwt_type>
+double time_queries(const bwt_type& bwt, const std::vector<std::string>& patterns, uint64_t& matches) {
+    using std::chrono::duration_cast;
+    using std::chrono::high_resolution_clock;
+    using std::chrono::nanoseconds;
+
+    // Best of a few rounds, the first one also warms up the index.
+    double best = std::numeric_limits<double>::max();
+    for (uint32_t round = 0; round < 3; round++) {
+        matches = 0;
+        auto start = high_resolution_clock::now();
+        for (const auto& p : patterns) {
+            matches += bwt.count(p);
+        }
+        auto end = high_resolution_clock::now();
+        double time = duration_cast<nanoseconds>(end - start).count();
+        best = time < best ? time : best;
+    }
+    return best / patterns.size();
+}
+
+template <class F>
+auto with_index(const std::string& in_file_path, bbwt::load_mode mode, bool run_block, bool space_op, F f) {
+    if (bbwt::container::is_container(in_file_path)) {
+        return bbwt::open_index(in_file_path, mode).visit(f);
+    } else if (run_block) {
+        bbwt::run<> bwt(in_file_path, mode);
+        return f(bwt);
+    } else if (space_op) {
+        bbwt::vbyte<> bwt(in_file_path, mode);
+        return f(bwt);
+    }
+    bbwt::two_byte<> bwt(in_file_path, mode);
+    return f(bwt);
+}
+
+void compare_pages(const std::string& in_file_path, std::ifstream& patterns, uint16_t p_len, bool run_block, bool space_op) {
+    std::vector<std::string> pats;
+    std::string p(p_len, '\0');
+    while (patterns.read(p.data(), p_len)) {
+        pats.push_back(p);
+    }
+    if (pats.size() == 0) {
+        std::cerr << "no patterns" << std::endl;
+        exit(1);
+    }
+    double times[2];
+    uint64_t matches[2];
+    bbwt::load_mode modes[2] = {bbwt::load_mode::parallel, bbwt::load_mode::huge};
+    for (uint32_t i = 0; i < 2; i++) {
+        auto backing = with_index(in_file_path, modes[i], run_block, space_op, [&](const auto& bwt) {
+            times[i] = time_queries(bwt, pats, matches[i]);
+            return bwt.backing();
+        });
+        std::cerr << bbwt::backing_name(backing) << ": " << times[i] << "ns per pattern ("
+                  << matches[i] << " matches)" << std::endl;
+    }
+    if (matches[0] != matches[1]) {
+        std::cerr << "Match counts differ" << std::endl;
+        exit(1);
+    }
+    std::cerr << "Speedup with huge pages: " << times[0] / times[1] << std::endl;
+}
+
 int main(int argc, char const* argv[]) {
     if (argc < 4) {
         std::cerr << "Input and pattern files, and pattern length are required\n" << std::endl;
@@ -61,6 +234,14 @@ int main(int argc, char const* argv[]) {
     bool space_op = false;
     bool run_block = false;
     bool output_time = true;
+    bool verify = false;
+    bool compare = false;
+    bool many = false;
+    bool locate = false;
+    uint64_t page_budget = 0;
+    uint64_t cache_entries = 0;
+    int mismatches = -1;
+    bbwt::load_mode mode = bbwt::load_mode::stream;
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-s") == 0) {
             space_op = true;
@@ -68,30 +249,89 @@ int main(int argc, char const* argv[]) {
             run_block = true;
         } else if (strcmp(argv[i], "-t") == 0) {
             output_time = false;
+        } else if (strcmp(argv[i], "-m") == 0) {
+            mode = bbwt::load_mode::mmap;
+        } else if (strcmp(argv[i], "-p") == 0) {
+            mode = bbwt::load_mode::parallel;
+        } else if (strcmp(argv[i], "-l") == 0) {
+            mode = bbwt::load_mode::huge;
+        } else if (strcmp(argv[i], "-L") == 0) {
+            compare = true;
+        } else if (strcmp(argv[i], "-b") == 0) {
+            mode = bbwt::load_mode::paged;
+            std::sscanf(argv[++i], "%lu", &page_budget);
+        } else if (strcmp(argv[i], "-B") == 0) {
+            many = true;
+        } else if (strcmp(argv[i], "-o") == 0) {
+            locate = true;
+        } else if (strcmp(argv[i], "-C") == 0) {
+            std::sscanf(argv[++i], "%lu", &cache_entries);
+        } else if (strcmp(argv[i], "-k") == 0) {
+            std::sscanf(argv[++i], "%d", &mismatches);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verify = true;
         } else if (in_file_path.size() == 0) {
             in_file_path = argv[i];
         } else if (patterns.size() == 0) {
             patterns = argv[i];
         } else {
-            std::sscanf(argv[i], "%u", &p_len);
+            std::sscanf(argv[i], "%hu", &p_len);
         }
     }
     if (p_len < 1) {
         std::cerr << "invalid pattern length" << std::endl;
         exit(1);
     }
+    if (verify) {
+        if (!bbwt::container::is_container(in_file_path)) {
+            std::cerr << in_file_path << " has no checksums to verify" << std::endl;
+        } else {
+            bbwt::container c(in_file_path);
+            if (!c.verify()) {
+                std::cerr << "Checksum mismatch in " << in_file_path << std::endl;
+                exit(1);
+            }
+        }
+    }
     std::ifstream p(patterns);
     std::cerr << "looking for patterns from " << patterns << " in " << in_file_path << std::endl;
+    if (compare) {
+        compare_pages(in_file_path, p, p_len, run_block, space_op);
+        return 0;
+    }
     std::cout << "Pattern\tcount\ttime" << std::endl;
-    std::pair<double, size_t> res;
     double bps = 0;
-    if (run_block) {
-        res = bench<bbwt::run<>>(in_file_path, p, output_time, bps, p_len);
-    } else if (space_op) {
-        res = bench<bbwt::vbyte<>>(in_file_path, p, output_time, bps, p_len);
-    } else {
-        res = bench<bbwt::two_byte<>>(in_file_path, p, output_time, bps, p_len);
-    }
+    std::pair<double, size_t> res = with_index(in_file_path, mode, run_block, space_op, [&](auto& bwt) {
+        if (mismatches >= 0) {
+            return bench_mismatches(bwt, p, mismatches, many, output_time, bps, p_len);
+        }
+        if (many) {
+            return bench_many(bwt, p, bps, p_len);
+        }
+        if (locate) {
+            return bench_locate(bwt, in_file_path, p, output_time, bps, p_len);
+        }
+        if (cache_entries) {
+            bbwt::interval_cache cache(cache_entries);
+            bwt.set_cache(&cache);
+            auto r = bench(bwt, p, output_time, bps, p_len);
+            bwt.set_cache(nullptr);
+            std::cerr << "Cache: " << cache.hits() << " / " << cache.lookups() << " hits ("
+                      << cache.hit_ratio() << "), " << cache.saved() << " symbols from cache" << std::endl;
+            return r;
+        }
+        if constexpr (requires { bwt.paging(); }) {
+            bwt.set_page_budget(page_budget);
+            auto r = bench(bwt, p, output_time, bps, p_len);
+            if (bwt.paging()) {
+                std::cerr << "Paging: " << bwt.paging()->faults() << " faults, "
+                          << bwt.paging()->evictions() << " evictions, "
+                          << bwt.paging()->resident() << " bytes resident" << std::endl;
+            }
+            return r;
+        }
+        return bench(bwt, p, output_time, bps, p_len);
+    });
     std::cerr << "Mean query time: " << res.first << " / " << res.second << " = " << (res.first / res.second) << "ns\n" 
               << " with " << bps << " bits per symbol" << std::endl;
 }
\ No newline at end of file
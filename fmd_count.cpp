@@ -0,0 +1,100 @@
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "include/types.hpp"
+
+void help() {
+    std::cout << "Count patterns on both strands with an FMD-index.\n\n";
+    std::cout << "Usage: fmd_count [options] <bwt_file> <patterns>\n";
+    std::cout << "   bwt_file   Path to an index of the BWT of a text with its reverse complement.\n";
+    std::cout << "   patterns   Path to file containing one pattern per line.\n";
+    std::cout << "   -c         Blocks contain a constant number of runs (make_bwt -c).\n";
+    std::cout << "   -m         Memory map the index instead of reading it.\n";
+    std::cout << "   -f         Search left to right with forward extensions.\n\n";
+    std::cout << "For each pattern P, writes P, the number of occurrences of P or of its\n"
+              << "reverse complement in the text, and the rows of P and of its reverse\n"
+              << "complement in the BWT. Bwt and pattern files are required.\n\n";
+    std::cout << "Example: fmd_count both_strands.rlbwt reads.txt" << std::endl;
+    exit(0);
+}
+
+template <class fmd_type>
+bbwt::bi_interval search(const fmd_type& fmd, const std::string& p, bool forward) {
+    if (!forward) {
+        return fmd.find(p);
+    }
+    bbwt::bi_interval x = fmd.init(p[0]);
+    for (size_t i = 1; i < p.size() && x.s > 0; i++) {
+        x = fmd.forward(x, p[i]);
+    }
+    return x;
+}
+
+template <class fmd_type>
+void run(const std::string& path, bbwt::load_mode mode, std::ifstream& patterns, bool forward) {
+    using std::chrono::duration_cast;
+    using std::chrono::high_resolution_clock;
+    using std::chrono::nanoseconds;
+
+    fmd_type fmd(path, mode);
+    std::cout << "Pattern\tcount\trows\treverse complement rows" << std::endl;
+    double total = 0;
+    uint64_t n = 0;
+    std::string p;
+    while (std::getline(patterns, p)) {
+        if (p.empty()) {
+            continue;
+        }
+        auto start = high_resolution_clock::now();
+        bbwt::bi_interval x = search(fmd, p, forward);
+        auto end = high_resolution_clock::now();
+        total += duration_cast<nanoseconds>(end - start).count();
+        n++;
+        if (x.s == 0) {
+            x = {0, 0, 0};
+        }
+        std::cout << p << "\t" << x.s << "\t" << x.k << "\t" << x.l << std::endl;
+    }
+    std::cerr << "Mean query time: " << total << " / " << n << " = " << total / (n ? n : 1)
+              << "ns\n with " << 8 * double(fmd.bytes()) / fmd.size() << " bits per symbol"
+              << std::endl;
+}
+
+int main(int argc, char const* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Input and pattern files are required\n" << std::endl;
+        help();
+    }
+    std::string in_file_path = "";
+    std::string patterns = "";
+    bool run_block = false;
+    bool forward = false;
+    bbwt::load_mode mode = bbwt::load_mode::stream;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0) {
+            run_block = true;
+        } else if (strcmp(argv[i], "-m") == 0) {
+            mode = bbwt::load_mode::mmap;
+        } else if (strcmp(argv[i], "-f") == 0) {
+            forward = true;
+        } else if (in_file_path.size() == 0) {
+            in_file_path = argv[i];
+        } else {
+            patterns = argv[i];
+        }
+    }
+    std::ifstream p(patterns);
+    if (!p) {
+        std::cerr << "Could not open " << patterns << std::endl;
+        exit(1);
+    }
+    if (run_block) {
+        run<bbwt::fmd_index<bbwt::run<>>>(in_file_path, mode, p, forward);
+    } else {
+        run<bbwt::fmd<>>(in_file_path, mode, p, forward);
+    }
+}
@@ -3,12 +3,15 @@
 #include <cstdint>
 #include <bit>
 
+#include "alphabet_meta.hpp"
+
 namespace bbwt {
 template <class dtype>
 class acgt_alphabet {
   private:
     
   public:
+    typedef static_meta<acgt_alphabet> meta_type;
     static const constexpr uint8_t width = 3;
     static constexpr uint8_t convert(uint8_t c) {
         switch (c) {
@@ -63,17 +66,19 @@ class acgt_alphabet {
         std::memset(this, 0, sizeof(acgt_alphabet));
     }
 
-    dtype p_sum(uint8_t c) const {
+    dtype p_sum(uint8_t c, const meta_type& = meta_type()) const {
         return counts_[c];
     }
 
-    void print() const {
+    void print(const meta_type& = meta_type()) const {
         for (uint16_t i = 0; i < 5; i++) {
             std::cerr << revert(i) << "(" << i << "): " << counts_[i] << std::endl;
         }
     }
 
-    static void write_statics(std::fstream&) {return; }
-    static uint64_t load_statics(std::fstream&) {return 0; }
+    template <class o_t>
+    static void write_statics(o_t&) {return; }
+    template <class i_t>
+    static uint64_t load_statics(i_t&) {return 0; }
 };
 } // namespace bbwt
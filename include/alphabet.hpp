@@ -2,43 +2,217 @@
 
 #include <endian.h>
 
+#include <algorithm>
+#include <bit>
 #include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace bbwt {
+
+// Symbol counts of a text, gathered in a pass over the input before building,
+// so partial sums can be packed to as few bits as the text needs.
+class symbol_counts {
+   private:
+    static const constexpr uint64_t SUPER_BLOCK_ELEMS = uint64_t(1) << 32;
+    uint64_t totals_[256];
+    uint64_t super_block_max_[256];
+    uint64_t current_[256];
+    uint64_t elems_;
+
+   public:
+    symbol_counts() : totals_(), super_block_max_(), current_(), elems_(0) {}
+
+    void add(uint8_t c, uint64_t length) {
+        totals_[c] += length;
+        while (length) {
+            uint64_t fill = SUPER_BLOCK_ELEMS - elems_ % SUPER_BLOCK_ELEMS;
+            fill = fill < length ? fill : length;
+            current_[c] += fill;
+            if (current_[c] > super_block_max_[c]) {
+                super_block_max_[c] = current_[c];
+            }
+            elems_ += fill;
+            length -= fill;
+            if (elems_ % SUPER_BLOCK_ELEMS == 0) {
+                std::memset(current_, 0, sizeof(current_));
+            }
+        }
+    }
+
+    uint64_t total(uint8_t c) const { return totals_[c]; }
+
+    // Largest count of c in any super block, capped to fit 32 bits.
+    uint64_t super_block_max(uint8_t c) const {
+        return super_block_max_[c] < SUPER_BLOCK_ELEMS ? super_block_max_[c]
+                                                       : SUPER_BLOCK_ELEMS - 1;
+    }
+
+    uint64_t size() const { return elems_; }
+};
+
 template <class dtype>
 class alphabet {
    private:
     typedef std::pair<uint64_t, std::pair<uint32_t, uint32_t>> L;
     typedef std::pair<uint32_t, std::pair<uint16_t, uint16_t>> S;
-    inline static uint8_t c_map[256];
-    inline static uint8_t r_map[256];
-    inline static L* L_map;
-    inline static S* S_map;
-    inline static uint32_t size_ = 0;
+    typedef std::conditional_t<sizeof(dtype) == 8, L, S> field;
 
    public:
-    inline static uint8_t width;
-    static uint8_t convert(uint8_t c) { return c_map[c]; }
-    static uint8_t revert(uint8_t c) { return r_map[c]; }
-    static uint16_t size() { return size_; }
-    template <class i_t>
-    static uint32_t load_statics(i_t& in_file) {
-        in_file.read(reinterpret_cast<char*>(&width), 1);
-        in_file.read(reinterpret_cast<char*>(&size_), 4);
-        in_file.read(reinterpret_cast<char*>(c_map), 256);
-        in_file.read(reinterpret_cast<char*>(r_map), 256);
-        uint32_t s;
-        in_file.read(reinterpret_cast<char*>(&s), 4);
-        if constexpr (sizeof(dtype) == 4) {
-            S_map = (S*)std::malloc(s);
-            in_file.read(reinterpret_cast<char*>(S_map), s);
-        } else {
-            L_map = (L*)std::malloc(s);
-            in_file.read(reinterpret_cast<char*>(L_map), s);
+    // Alphabet of one loaded index, shared by all of its partial sums and
+    // blocks. Field layout is kept first so p_sum only touches one line.
+    class meta_type {
+        friend class alphabet;
+
+       private:
+        const field* map_;
+        uint16_t size_;
+
+       public:
+        uint8_t width;
+
+       private:
+        uint8_t c_map_[256];
+        uint8_t r_map_[256];
+        // Converted symbols in increasing order of symbol.
+        uint8_t v_map_[256];
+        // Number of symbols smaller than each symbol.
+        uint8_t l_map_[256];
+        std::vector<field> fields_;
+
+        void map_values() {
+            for (uint16_t k = 0; k < fields_.size(); k++) {
+                v_map_[k] = k;
+            }
+            std::sort(v_map_, v_map_ + fields_.size(),
+                      [&](uint8_t a, uint8_t b) { return r_map_[a] < r_map_[b]; });
+            uint16_t k = 0;
+            for (uint16_t c = 0; c < 256; c++) {
+                l_map_[c] = k;
+                k += k < fields_.size() && r_map_[v_map_[k]] == c;
+            }
         }
-        return s + 2 * 256 + sizeof(L*) + sizeof(S*) + 1;
-    }
+
+       public:
+        meta_type()
+            : map_(nullptr), size_(0), width(0), c_map_(), r_map_(), v_map_(), l_map_() {}
+
+        // Symbols are numbered by increasing frequency. Partial sum fields
+        // are packed big-endian with just enough bits for the largest value
+        // they hold, and so that each field can be read with one dtype load.
+        meta_type(const symbol_counts& counts) : meta_type() {
+            std::vector<std::pair<uint64_t, uint8_t>> order;
+            for (uint16_t c = 0; c < 256; c++) {
+                if (counts.total(c)) {
+                    order.push_back({counts.total(c), c});
+                }
+            }
+            std::sort(order.begin(), order.end());
+            for (uint16_t i = 0; i < order.size(); i++) {
+                c_map_[order[i].second] = i;
+                r_map_[i] = order[i].second;
+            }
+            width = order.size() > 1 ? std::bit_width(order.size() - 1) : 1;
+            const int32_t SPAN = sizeof(dtype) - 1;
+            uint64_t used_bits = 0;
+            for (auto e : order) {
+                uint64_t max = sizeof(dtype) == 8 ? counts.total(e.second)
+                                                  : counts.super_block_max(e.second);
+                uint16_t bits = 64 - __builtin_clzll(max);
+                int32_t start = used_bits / 8;
+                uint16_t start_offset = used_bits % 8;
+                int32_t end = (used_bits + bits) / 8;
+                uint16_t end_offset = (used_bits + bits) % 8;
+                if (start + SPAN < end) {
+                    used_bits += 8 - start_offset;
+                    end_offset += 8 - start_offset;
+                }
+                uint16_t shift = 8 - end_offset;
+                start = end - SPAN;
+                if (start < 0) {
+                    shift += -start * 8;
+                    start = 0;
+                }
+                field f;
+                f.first = (uint64_t(1) << bits) - 1;
+                f.second.first = start;
+                f.second.second = shift;
+                fields_.push_back(f);
+                used_bits += bits;
+            }
+            size_ = used_bits / 8 + (used_bits % 8 ? 1 : 0);
+            size_ = size_ < sizeof(dtype) ? sizeof(dtype) : size_;
+            map_ = fields_.data();
+            map_values();
+        }
+
+        meta_type(const meta_type&) = delete;
+        meta_type& operator=(const meta_type&) = delete;
+
+        meta_type(meta_type&& other) { *this = std::move(other); }
+
+        meta_type& operator=(meta_type&& other) {
+            size_ = other.size_;
+            width = other.width;
+            std::memcpy(c_map_, other.c_map_, 256);
+            std::memcpy(r_map_, other.r_map_, 256);
+            std::memcpy(v_map_, other.v_map_, 256);
+            std::memcpy(l_map_, other.l_map_, 256);
+            fields_ = std::move(other.fields_);
+            map_ = fields_.data();
+            other.map_ = nullptr;
+            return *this;
+        }
+
+        uint8_t convert(uint8_t c) const { return c_map_[c]; }
+        uint8_t revert(uint8_t c) const { return r_map_[c]; }
+        // Converted symbol with the k-th smallest symbol, for k < sigma().
+        uint8_t by_value(uint16_t k) const { return v_map_[k]; }
+        // Number of symbols smaller than c. c is not converted.
+        uint16_t less_count(uint8_t c) const { return l_map_[c]; }
+
+        // out[k] is all ones if revert(k) < c and zero otherwise, for masking
+        // run lengths in rank_less. out needs room for sigma() entries.
+        void less_masks(uint8_t c, uint32_t* out) const {
+            for (uint16_t k = 0; k < fields_.size(); k++) {
+                out[k] = r_map_[k] < c ? ~uint32_t(0) : 0;
+            }
+        }
+        uint16_t size() const { return size_; }
+        uint16_t sigma() const { return fields_.size(); }
+
+        template <class o_t>
+        void write_statics(o_t& out) const {
+            uint32_t size = size_;
+            uint32_t s = fields_.size() * sizeof(field);
+            out.write(reinterpret_cast<const char*>(&width), 1);
+            out.write(reinterpret_cast<const char*>(&size), 4);
+            out.write(reinterpret_cast<const char*>(c_map_), 256);
+            out.write(reinterpret_cast<const char*>(r_map_), 256);
+            out.write(reinterpret_cast<const char*>(&s), 4);
+            out.write(reinterpret_cast<const char*>(fields_.data()), s);
+        }
+
+        template <class i_t>
+        uint64_t load_statics(i_t& in_file) {
+            uint32_t size;
+            in_file.read(reinterpret_cast<char*>(&width), 1);
+            in_file.read(reinterpret_cast<char*>(&size), 4);
+            in_file.read(reinterpret_cast<char*>(c_map_), 256);
+            in_file.read(reinterpret_cast<char*>(r_map_), 256);
+            uint32_t s;
+            in_file.read(reinterpret_cast<char*>(&s), 4);
+            fields_.resize(s / sizeof(field));
+            in_file.read(reinterpret_cast<char*>(fields_.data()), s);
+            size_ = size;
+            map_ = fields_.data();
+            map_values();
+            return s;
+        }
+    };
 
     alphabet() = delete;
     alphabet(const alphabet& other) = delete;
@@ -46,23 +220,63 @@ class alphabet {
     alphabet& operator=(const alphabet& other) = delete;
     alphabet& operator=(alphabet&& other) = delete;
 
-    dtype p_sum(uint8_t c) const {
+    void add(uint8_t c, dtype v, const meta_type& m) {
+        const field& f = m.map_[c];
+        dtype* d = reinterpret_cast<dtype*>(reinterpret_cast<uint8_t*>(this) +
+                                            f.second.first);
+        dtype mask = dtype(f.first) << f.second.second;
+        if constexpr (sizeof(dtype) == 8) {
+            dtype w = be64toh(d[0]);
+            v += (w & mask) >> f.second.second;
+            d[0] = htobe64((w & ~mask) | (v << f.second.second));
+        } else {
+            dtype w = be32toh(d[0]);
+            v += (w & mask) >> f.second.second;
+            d[0] = htobe32((w & ~mask) | (v << f.second.second));
+        }
+    }
+
+    void clear(const meta_type& m) { std::memset(this, 0, m.size()); }
+
+    dtype p_sum(uint8_t c, const meta_type& m) const {
+        const field& f = m.map_[c];
+        const dtype* d = reinterpret_cast<const dtype*>(
+            reinterpret_cast<const uint8_t*>(this) + f.second.first);
         if constexpr (sizeof(dtype) == 8) {
-            dtype d = be64toh(reinterpret_cast<const dtype*>(
-                reinterpret_cast<const uint8_t*>(this) +
-                L_map[c].second.first)[0]);
-            return (d >> L_map[c].second.second) & L_map[c].first;
+            return (be64toh(d[0]) >> f.second.second) & f.first;
         } else {
-            dtype d = be32toh(reinterpret_cast<const dtype*>(
-                reinterpret_cast<const uint8_t*>(this) +
-                S_map[c].second.first)[0]);
-            return (d >> S_map[c].second.second) & S_map[c].first;
+            return (be32toh(d[0]) >> f.second.second) & f.first;
+        }
+    }
+
+    // Sum of p_sum over the symbols smaller than c. c is not converted.
+    dtype p_sum_less(uint8_t c, const meta_type& m) const {
+        dtype res = 0;
+        for (uint16_t k = 0; k < m.less_count(c); k++) {
+            res += p_sum(m.by_value(k), m);
+        }
+        return res;
+    }
+
+    // out[k] is the sum of p_sum over the k smallest symbols, for k <=
+    // sigma(), so that p_sum_less(c, m) is out[m.less_count(c)].
+    void less_sums(dtype* out, const meta_type& m) const {
+        out[0] = 0;
+        for (uint16_t k = 0; k < m.sigma(); k++) {
+            out[k + 1] = out[k] + p_sum(m.by_value(k), m);
+        }
+    }
+
+    // Adds p_sum(c, m) to out[c] for every symbol c.
+    void add_p_sums(uint64_t* out, const meta_type& m) const {
+        for (uint16_t c = 0; c < m.sigma(); c++) {
+            out[c] += p_sum(c, m);
         }
     }
 
-    void print() const {
-        for (uint16_t i = 0; i < 6; i++) {
-            std::cerr << int(revert(i)) << ": " << p_sum(i) << std::endl;
+    void print(const meta_type& m) const {
+        for (uint16_t i = 0; i < m.fields_.size(); i++) {
+            std::cerr << int(m.revert(i)) << ": " << p_sum(i, m) << std::endl;
         }
     }
 };
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+namespace bbwt {
+
+// Alphabet metadata for alphabets that are fixed at compile time.
+//
+// Blocks and partial sums are given a meta object of their index for anything
+// that depends on the alphabet. For compile time alphabets the object is empty
+// and everything folds to constants, so passing it costs nothing.
+template <class alphabet_type>
+struct static_meta {
+    static const constexpr uint8_t width = alphabet_type::width;
+
+    static constexpr uint8_t convert(uint8_t c) {
+        return alphabet_type::convert(c);
+    }
+    static constexpr uint8_t revert(uint8_t c) {
+        return alphabet_type::revert(c);
+    }
+    static constexpr uint16_t size() { return sizeof(alphabet_type); }
+
+    template <class i_t>
+    static uint64_t load_statics(i_t& in_file) {
+        return alphabet_type::load_statics(in_file);
+    }
+};
+}  // namespace bbwt
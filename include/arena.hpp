@@ -0,0 +1,130 @@
+#pragma once
+
+#include <sys/mman.h>
+
+#include <cstdint>
+#include <iostream>
+#include <utility>
+
+namespace bbwt {
+
+static const constexpr uint64_t HUGE_PAGE = uint64_t(1) << 21;
+
+// What the arena memory ended up being backed by.
+enum class page_backing { normal, transparent_huge, explicit_huge };
+
+inline const char* backing_name(page_backing b) {
+    switch (b) {
+        case page_backing::explicit_huge:
+            return "explicit huge pages";
+        case page_backing::transparent_huge:
+            return "transparent huge pages";
+        default:
+            return "normal pages";
+    }
+}
+
+// One region of memory that index data is bump allocated from, to keep the
+// number of pages (and TLB misses) down. Memory is released all at once.
+//
+// With huge pages, explicit 2 MiB pages (MAP_HUGETLB) are tried first. If none
+// are available a 2 MiB aligned region is advised for transparent huge pages,
+// and if that is not supported either, normal pages are used.
+class arena {
+   private:
+    uint8_t* data_;
+    uint64_t capacity_;
+    uint64_t used_;
+    page_backing backing_;
+
+   public:
+    arena() : data_(nullptr), capacity_(0), used_(0), backing_(page_backing::normal) {}
+
+    arena(uint64_t capacity, bool huge)
+        : data_(nullptr), capacity_(capacity), used_(0), backing_(page_backing::normal) {
+        if (capacity_ == 0) {
+            return;
+        }
+        void* addr = MAP_FAILED;
+        if (huge) {
+            capacity_ = (capacity_ + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+            addr = mmap(nullptr, capacity_, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (addr != MAP_FAILED) {
+                backing_ = page_backing::explicit_huge;
+            } else {
+                addr = map_aligned();
+                if (madvise(addr, capacity_, MADV_HUGEPAGE) == 0) {
+                    backing_ = page_backing::transparent_huge;
+                }
+            }
+        } else {
+            addr = mmap(nullptr, capacity_, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (addr == MAP_FAILED) {
+                std::cerr << "Allocating " << capacity_ << " bytes failed!" << std::endl;
+                exit(1);
+            }
+        }
+        data_ = reinterpret_cast<uint8_t*>(addr);
+    }
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    arena(arena&& other)
+        : data_(std::exchange(other.data_, nullptr)),
+          capacity_(std::exchange(other.capacity_, 0)),
+          used_(std::exchange(other.used_, 0)),
+          backing_(std::exchange(other.backing_, page_backing::normal)) {}
+
+    arena& operator=(arena&& other) {
+        if (data_ != nullptr) {
+            munmap(data_, capacity_);
+        }
+        data_ = std::exchange(other.data_, nullptr);
+        capacity_ = std::exchange(other.capacity_, 0);
+        used_ = std::exchange(other.used_, 0);
+        backing_ = std::exchange(other.backing_, page_backing::normal);
+        return *this;
+    }
+
+    ~arena() {
+        if (data_ != nullptr) {
+            munmap(data_, capacity_);
+        }
+    }
+
+    // Zeroed memory for bytes bytes, aligned to align (a power of 2).
+    uint8_t* alloc(uint64_t bytes, uint64_t align = 64) {
+        uint64_t start = (used_ + align - 1) & ~(align - 1);
+        if (start + bytes > capacity_) {
+            std::cerr << "Arena of " << capacity_ << " bytes exhausted" << std::endl;
+            exit(1);
+        }
+        used_ = start + bytes;
+        return data_ + start;
+    }
+
+    page_backing backing() const { return backing_; }
+    uint64_t capacity() const { return capacity_; }
+
+   private:
+    // Map capacity_ bytes starting at a huge page boundary.
+    void* map_aligned() {
+        void* addr = mmap(nullptr, capacity_ + HUGE_PAGE, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED) {
+            std::cerr << "Allocating " << capacity_ << " bytes failed!" << std::endl;
+            exit(1);
+        }
+        uint8_t* raw = reinterpret_cast<uint8_t*>(addr);
+        uint64_t head = (HUGE_PAGE - reinterpret_cast<uint64_t>(raw) % HUGE_PAGE) % HUGE_PAGE;
+        if (head) {
+            munmap(raw, head);
+        }
+        munmap(raw + head + capacity_, HUGE_PAGE - head);
+        return raw + head;
+    }
+};
+}  // namespace bbwt
@@ -66,10 +66,18 @@ class b_heap {
     uint64_t levels_;
     uint64_t node_count_;
     uint64_t* node_offsets_;
+    uint64_t size_;
+    bool owned_;
 
    public:
-    b_heap() {};
-    b_heap(item* data, uint64_t n) : levels_(1) {
+    b_heap()
+        : nodes_(nullptr),
+          levels_(0),
+          node_count_(0),
+          node_offsets_(nullptr),
+          size_(0),
+          owned_(false) {}
+    b_heap(item* data, uint64_t n) : levels_(1), size_(n), owned_(true) {
         uint64_t nn = n / block_size + (n % block_size ? 1 : 0);
         uint64_t leaves = nn;
         while (nn > block_size) {
@@ -106,21 +114,47 @@ class b_heap {
 
     template<class IS>
     uint64_t load(IS& in_stream) {
+        uint64_t res = load(in_stream, [](uint64_t n) { return (uint8_t*)malloc(n); });
+        owned_ = true;
+        return res;
+    }
+
+    // Load nodes to memory given by alloc(bytes). The memory is not freed.
+    template<class IS, class A>
+    uint64_t load(IS& in_stream, A alloc) {
         in_stream.read(reinterpret_cast<char*>(&levels_), sizeof(uint64_t));
         in_stream.read(reinterpret_cast<char*>(&node_count_), sizeof(uint64_t));
         uint64_t data_bytes;
         in_stream.read(reinterpret_cast<char*>(&data_bytes), sizeof(uint64_t));
-        nodes_ = (node*)malloc(data_bytes);
+        nodes_ = reinterpret_cast<node*>(alloc(data_bytes));
         in_stream.read(reinterpret_cast<char*>(nodes_), data_bytes);
         node_offsets_ = reinterpret_cast<uint64_t*>(nodes_ + node_count_);
+        size_ = (data_bytes - node_count_ * sizeof(node)) / sizeof(uint64_t);
+        owned_ = false;
         return sizeof(b_heap) + data_bytes;
     }
 
+    // Use a serialized b_heap in place, without copying or taking ownership.
+    // Returns the number of serialized bytes starting at data.
+    uint64_t wrap(const uint8_t* data) {
+        std::memcpy(&levels_, data, sizeof(uint64_t));
+        std::memcpy(&node_count_, data + sizeof(uint64_t), sizeof(uint64_t));
+        uint64_t data_bytes;
+        std::memcpy(&data_bytes, data + 2 * sizeof(uint64_t), sizeof(uint64_t));
+        nodes_ = reinterpret_cast<node*>(const_cast<uint8_t*>(data) + 3 * sizeof(uint64_t));
+        node_offsets_ = reinterpret_cast<uint64_t*>(nodes_ + node_count_);
+        size_ = (data_bytes - node_count_ * sizeof(node)) / sizeof(uint64_t);
+        owned_ = false;
+        return 3 * sizeof(uint64_t) + data_bytes;
+    }
+
     b_heap(b_heap& rhs) {
         nodes_ = std::exchange(rhs.nodes_, nullptr);
         levels_ = std::exchange(rhs.levels_, 0);
         node_count_ = std::exchange(rhs.node_count_, 0);
         node_offsets_ = std::exchange(rhs.node_offsets_, nullptr);
+        size_ = std::exchange(rhs.size_, 0);
+        owned_ = std::exchange(rhs.owned_, false);
     }
 
     b_heap& operator=(b_heap& rhs) {
@@ -128,6 +162,8 @@ class b_heap {
         levels_ = std::exchange(rhs.levels_, 0);
         node_count_ = std::exchange(rhs.node_count_, 0);
         node_offsets_ = std::exchange(rhs.node_offsets_, nullptr);
+        size_ = std::exchange(rhs.size_, 0);
+        owned_ = std::exchange(rhs.owned_, false);
         return *this;
     }
 
@@ -142,11 +178,21 @@ class b_heap {
     }
 
     ~b_heap() {
-        if (nodes_ != nullptr) {
+        if (nodes_ != nullptr && owned_) {
             free(nodes_);
         }
     }
 
+    // Number of items.
+    uint64_t size() const { return size_; }
+
+    // Item i < size() in increasing key order. Keys are the leaf level.
+    item get(uint64_t i) const {
+        const uint64_t* keys = reinterpret_cast<const uint64_t*>(
+            nodes_ + node_count_ - (size_ + block_size - 1) / block_size);
+        return {keys[i], node_offsets_[i]};
+    }
+
     item find(uint64_t q) const {
         item ret = {0, 0};
         uint64_t n_idx = 0;
@@ -158,6 +204,37 @@ class b_heap {
         return {ret.first, node_offsets_[ret.second]};
     }
 
+    // find for each of q[0..n), n <= N, to res. All queries descend one level
+    // at a time, and the next node of every query is prefetched before any of
+    // them is searched, so that the cache misses overlap.
+    template <uint64_t N>
+    void find_batch(const uint64_t* q, item* res, uint64_t n) const {
+        constexpr uint64_t lines = CACHE_LINE / sizeof(uint64_t);
+        uint64_t n_idx[N];
+        for (uint64_t k = 0; k < n; k++) {
+            res[k] = {0, 0};
+            n_idx[k] = 0;
+        }
+        for (uint64_t i = 0; i <= levels_; i++) {
+            for (uint64_t k = 0; k < n; k++) {
+                for (uint64_t l = 0; l < block_size; l += lines) {
+                    __builtin_prefetch(nodes_[n_idx[k]].children + l);
+                }
+            }
+            for (uint64_t k = 0; k < n; k++) {
+                auto r = nodes_[n_idx[k]].find(q[k]);
+                res[k] = {r.first, res[k].second * block_size + r.second};
+                n_idx[k] = n_idx[k] * block_size + 1 + r.second;
+            }
+        }
+        for (uint64_t k = 0; k < n; k++) {
+            __builtin_prefetch(node_offsets_ + res[k].second);
+        }
+        for (uint64_t k = 0; k < n; k++) {
+            res[k].second = node_offsets_[res[k].second];
+        }
+    }
+
     template<class T>
     item find(uint64_t q, T& offset) const {
         item ret = {0, offset.second};
@@ -170,6 +247,31 @@ class b_heap {
         return {ret.first, node_offsets_[ret.second]};
     }
 
+    // Index of the item find(q) gives, so that find(q) is get(index(q)).
+    uint64_t index(uint64_t q) const {
+        uint64_t ret = 0;
+        uint64_t n_idx = 0;
+        for (uint64_t i = 0; i <= levels_; i++) {
+            auto res = nodes_[n_idx].find(q);
+            ret = ret * block_size + res.second;
+            n_idx = n_idx * block_size + 1 + res.second;
+        }
+        return ret;
+    }
+
+    // index(q) starting from a node given by offset, as in find(q, offset).
+    template<class T>
+    uint64_t index(uint64_t q, T& offset) const {
+        uint64_t ret = offset.second;
+        uint64_t n_idx = offset.first;
+        while (n_idx < node_count_) {
+            auto res = nodes_[n_idx].find(q);
+            ret = ret * block_size + res.second;
+            n_idx = n_idx * block_size + 1 + res.second;
+        }
+        return ret;
+    }
+
     item short_cut(uint64_t a, uint64_t b) {
         item ret = {0, 0};
         uint64_t n_idx = 0;
@@ -1,15 +1,37 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <random>
 #include <cassert>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <fstream>
+#include <tuple>
 #include <utility>
 #include <vector>
 #include <cstdint>
 
+#include "alphabet.hpp"
+#include "arena.hpp"
+#include "container.hpp"
+#include "interval_cache.hpp"
+#include "kmer_table.hpp"
+#include "locate.hpp"
+#include "mapped_file.hpp"
+#include "pager.hpp"
+#include "parallel_reader.hpp"
+
+#ifndef RANK_GROUP
+#define RANK_GROUP 16
+#endif
+
+#ifndef COUNT_WINDOW
+#define COUNT_WINDOW 16
+#endif
+
 namespace bbwt {
 template <class bwt_type>
 class block_rlbwt_builder {
@@ -21,16 +43,17 @@ class block_rlbwt_builder {
     typedef typename bwt_type::block_alphabet_type block_alphabet_type;
     typedef typename bwt_type::block_type block_type;
 
+    typename alphabet_type::meta_type alpha_;
+    typename block_alphabet_type::meta_type block_alpha_;
     uint64_t char_counts_[257];
     uint32_t run_count_;
     uint32_t dense_blocks_;
-    std::string prefix_;
-    std::string suffix_;
-    std::vector<alphabet_type> block_counts_;
+    std::vector<uint8_t> block_counts_;
     std::vector<bool> block_reprs_;
-    alphabet_type super_block_cumulative_;
+    std::vector<uint8_t> super_block_cumulative_;
     std::vector<uint64_t> block_offsets_;
-    block_alphabet_type block_cumulative_;
+    std::vector<uint64_t> directory_;
+    std::vector<uint8_t> block_cumulative_;
     uint64_t super_block_bytes_;
     uint64_t super_block_size_;
     uint64_t elems_;
@@ -40,37 +63,43 @@ class block_rlbwt_builder {
     uint32_t block_elems_;
     uint32_t block_bytes_;
     uint32_t blocks_in_super_block_;
-    std::fstream out_;
+    container_writer out_;
+    std::unique_ptr<run_starts> runs_;
 
    public:
-    block_rlbwt_builder(std::string out_file)
-        : char_counts_(),
+    // counts are the symbol counts of the whole input, see symbol_counts.
+    block_rlbwt_builder(std::string out_file, const symbol_counts& counts)
+        : alpha_(counts),
+          block_alpha_(counts),
+          char_counts_(),
           run_count_(0),
           dense_blocks_(0),
           block_counts_(),
           block_reprs_(),
-          super_block_cumulative_(),
+          super_block_cumulative_(alpha_.size()),
           block_offsets_(),
-          block_cumulative_(),
-          super_block_bytes_(sizeof(block_alphabet_type)),
+          directory_(),
+          block_cumulative_(block_alpha_.size()),
+          super_block_bytes_(block_alpha_.size()),
           super_block_size_(
               BLOCKS_IN_SUPER_BLOCK *
-              (block_type::min_size + sizeof(block_alphabet_type))),
+              (block_type::min_size + block_alpha_.size())),
           elems_(0),
           current_block_(),
           block_elems_(0),
           block_bytes_(0),
-          blocks_in_super_block_(0) {
-        size_t loc = out_file.find_last_of('.');
-        if (loc == std::string::npos) {
-            prefix_ = out_file;
-            suffix_ = "";
-        } else {
-            prefix_ = out_file.substr(0, loc);
-            suffix_ = out_file.substr(loc);
-        }
-        out_.open(prefix_ + "_data" + suffix_, std::ios::binary | std::ios::out);
-        block_counts_.push_back(super_block_cumulative_);
+          blocks_in_super_block_(0),
+          out_(out_file, bwt_type::kind, block_type::encoding, block_type::cap),
+          runs_() {
+        out_.begin(section::statics);
+        alpha_.write_statics(out_);
+        block_alpha_.write_statics(out_);
+        bwt_type::super_block_type::write_statics(out_);
+        block_type::write_statics(out_);
+        out_.end();
+        out_.begin(section::block_data, HUGE_ALIGN);
+        block_counts_.insert(block_counts_.end(), super_block_cumulative_.begin(),
+                             super_block_cumulative_.end());
         current_super_block_ = (uint8_t*)calloc(super_block_size_, 1);
         scratch_ =
             (uint8_t**)malloc(block_type::scratch_blocks * sizeof(uint8_t*));
@@ -79,30 +108,34 @@ class block_rlbwt_builder {
         }
     }
 
+    // Keeps the positions where runs start, for locator::build.
+    void track_runs() { runs_ = std::make_unique<run_starts>(); }
+    const run_starts& runs() const { return *runs_; }
+
     void append(uint8_t head, uint32_t length) {
+        if (runs_) {
+            runs_->add(head, length);
+        }
         char_counts_[head] += length;
-        head = alphabet_type::convert(head);
+        head = alpha_.convert(head);
         while (length) {
             run_count_++;
             if (length + block_elems_ < bwt_type::cap) {
-                block_cumulative_.add(head, length);
-                super_block_cumulative_.add(head, length);
-                block_bytes_ = current_block_.append(head, length, scratch_);
+                count(head, length);
+                block_bytes_ = current_block_.append(head, length, scratch_, block_alpha_);
                 block_elems_ += length;
                 elems_ += length;
                 return;
             } else if (length + block_elems_ == bwt_type::cap) [[unlikely]] {
-                block_cumulative_.add(head, length);
-                super_block_cumulative_.add(head, length);
-                block_bytes_ = current_block_.append(head, length, scratch_);
+                count(head, length);
+                block_bytes_ = current_block_.append(head, length, scratch_, block_alpha_);
                 elems_ += length;
                 commit();
                 return;
             } else {
                 uint32_t fill = bwt_type::cap - block_elems_;
-                block_cumulative_.add(head, fill);
-                super_block_cumulative_.add(head, fill);
-                block_bytes_ = current_block_.append(head, fill, scratch_);
+                count(head, fill);
+                block_bytes_ = current_block_.append(head, fill, scratch_, block_alpha_);
                 elems_ += fill;
                 commit();
                 length -= fill;
@@ -117,7 +150,8 @@ class block_rlbwt_builder {
         if (blocks_in_super_block_) {
             write_super_block();
         }
-        out_.close();
+        directory_.push_back(out_.section_bytes());
+        out_.end();
         uint64_t p_v = 0;
         for (size_t i = 0; i < 257; i++) {
             uint64_t tmp = char_counts_[i];
@@ -151,11 +185,15 @@ class block_rlbwt_builder {
     }
 
    private:
+    void count(uint8_t head, uint32_t length) {
+        reinterpret_cast<block_alphabet_type*>(block_cumulative_.data())
+            ->add(head, length, block_alpha_);
+        reinterpret_cast<alphabet_type*>(super_block_cumulative_.data())
+            ->add(head, length, alpha_);
+    }
+
     void write_super_block() {
-        uint64_t file_bytes =
-            super_block_bytes_ +
-            sizeof(uint64_t) * bwt_type::super_block_type::blocks;
-        out_.write(reinterpret_cast<char*>(&file_bytes), sizeof(uint64_t));
+        directory_.push_back(out_.section_bytes());
         out_.write(reinterpret_cast<char*>(block_offsets_.data()),
                   sizeof(uint64_t) * block_offsets_.size());
         for (uint64_t i = block_offsets_.size();
@@ -165,13 +203,14 @@ class block_rlbwt_builder {
         }
         out_.write(reinterpret_cast<char*>(current_super_block_),
                   super_block_bytes_);
-        block_counts_.push_back(super_block_cumulative_);
+        block_counts_.insert(block_counts_.end(), super_block_cumulative_.begin(),
+                             super_block_cumulative_.end());
 
-        block_cumulative_.clear();
+        std::fill(block_cumulative_.begin(), block_cumulative_.end(), 0);
         block_offsets_.clear();
         std::memset(current_super_block_, 0,
                     sizeof(uint8_t) * super_block_size_);
-        super_block_bytes_ = sizeof(block_alphabet_type);
+        super_block_bytes_ = block_alpha_.size();
         blocks_in_super_block_ = 0;
     }
 
@@ -183,12 +222,12 @@ class block_rlbwt_builder {
             block_reprs_.push_back(false);
         }
         run_count_ = 0;
-        if (super_block_bytes_ + block_bytes_ + block_alphabet_type::size() > super_block_size_) {
+        if (super_block_bytes_ + block_bytes_ + block_alpha_.size() > super_block_size_) {
             uint64_t new_size = super_block_bytes_ + block_bytes_;
             if (!last_block) {
                 new_size +=
                     (BLOCKS_IN_SUPER_BLOCK - blocks_in_super_block_ - 1) *
-                    (block_type::min_size + sizeof(block_alphabet_type));
+                    (block_type::min_size + block_alpha_.size());
             }
             current_super_block_ =
                 (uint8_t*)realloc(current_super_block_, new_size);
@@ -215,15 +254,15 @@ class block_rlbwt_builder {
         if (!last_block && blocks_in_super_block_ < BLOCKS_IN_SUPER_BLOCK)
             [[likely]] {
             std::memcpy(current_super_block_ + super_block_bytes_,
-                        &block_cumulative_, block_alphabet_type::size());
-            super_block_bytes_ += block_alphabet_type::size();
+                        block_cumulative_.data(), block_alpha_.size());
+            super_block_bytes_ += block_alpha_.size();
         } else {
             write_super_block();
         }
     }
 
     void write_root() {
-        uint64_t n_blocks = block_counts_.size() - 1;
+        uint64_t n_blocks = block_counts_.size() / alpha_.size() - 1;
 
         std::cerr << "Writing \"root\" of " << block_type::cap << "-sb-rlbwt to file\n"
                   << " Seen " << n_blocks << " super blocks\n"
@@ -233,19 +272,18 @@ class block_rlbwt_builder {
                   << 100.0 * dense_blocks_ / block_reprs_.size() << " %)"
                   << std::endl;
 
-        std::fstream out;
-        out.open(prefix_ + suffix_, std::ios::binary | std::ios::out);
-        alphabet_type::write_statics(out);
-        block_alphabet_type::write_statics(out);
-        bwt_type::super_block_type::write_statics(out);
-        block_type::write_statics(out);
-        uint64_t bytes = sizeof(alphabet_type) * block_counts_.size();
-        out.write(reinterpret_cast<char*>(&bytes), sizeof(uint64_t));
-        out.write(reinterpret_cast<char*>(&elems_), sizeof(uint64_t));
-        out.write(reinterpret_cast<char*>(&n_blocks), sizeof(uint64_t));
-        out.write(reinterpret_cast<char*>(block_counts_.data()), bytes);
-        out.write(reinterpret_cast<char*>(char_counts_), sizeof(uint64_t) * 257);
-        out.close();
+        out_.begin(section::p_sums);
+        out_.write(reinterpret_cast<char*>(block_counts_.data()),
+                   block_counts_.size());
+        out_.end();
+        out_.begin(section::directory);
+        out_.write(reinterpret_cast<char*>(directory_.data()),
+                   sizeof(uint64_t) * directory_.size());
+        out_.end();
+        out_.begin(section::char_counts);
+        out_.write(reinterpret_cast<char*>(char_counts_), sizeof(uint64_t) * 257);
+        out_.end();
+        out_.finalize(elems_, n_blocks);
     }
 };
 
@@ -255,6 +293,7 @@ class block_rlbwt {
     typedef super_block_type_ super_block_type;
     typedef alphabet_type_ alphabet_type;
     typedef block_rlbwt_builder<block_rlbwt> builder;
+    static const constexpr index_kind kind = index_kind::block;
 
    private:
     static const constexpr uint64_t SUPER_BLOCK_ELEMS = uint64_t(1) << 32;
@@ -264,61 +303,58 @@ class block_rlbwt {
     uint64_t char_counts_[257];
     uint8_t* p_sums_;
     std::vector<super_block_type*> s_blocks_;
+    typename alphabet_type::meta_type alpha_;
+    typename super_block_type::meta_type block_alpha_;
+    load_mode mode_;
+    mapped_file root_map_;
+    mapped_file data_map_;
+    arena arena_;
+    std::unique_ptr<pager> pager_;
+    kmer_table kmers_;
+    interval_cache* cache_;
+    // less_sums of the root partial sums, and of the block partial sums
+    // after build_less_sums.
+    std::vector<uint64_t> root_less_;
+    std::vector<uint32_t> block_less_;
 
    public:
     static const constexpr uint32_t cap = super_block_type::cap;
 
     static_assert(SUPER_BLOCK_ELEMS % cap == 0);
+    static const constexpr uint64_t PAGE_GROUPS =
+        (super_block_type::blocks + PAGE_GROUP - 1) / PAGE_GROUP;
 
     typedef typename super_block_type_::block_type block_type;
     typedef typename block_type::alphabet_type block_alphabet_type;
 
-    block_rlbwt(std::string path) : bytes_(sizeof(block_rlbwt)) {
-        std::fstream in_file;
-        in_file.open(path, std::ios::binary | std::ios::in);
-        if (in_file.fail()) {
-            std::cerr << " -> Failed" << std::endl;
-            exit(1);
-        }
-        bytes_ += alphabet_type::load_statics(in_file);
-        bytes_ += block_alphabet_type::load_statics(in_file);
-        bytes_ += super_block_type::load_statics(in_file);
-        bytes_ += block_type::load_statics(in_file);
-        uint64_t data_bytes;
-        in_file.read(reinterpret_cast<char*>(&data_bytes), sizeof(uint64_t));
-        in_file.read(reinterpret_cast<char*>(&size_), sizeof(uint64_t));
-        in_file.read(reinterpret_cast<char*>(&block_count_), sizeof(uint64_t));
-#ifdef VERB
-        std::cerr << data_bytes << " bytes of data\n"
-                  << size_ << " logical elements\n"
-                  << "in " << block_count_ << " super blocks" << std::endl;
-#endif
-        p_sums_ = (uint8_t*)std::malloc(data_bytes);
-        in_file.read(reinterpret_cast<char*>(p_sums_), data_bytes);
-        bytes_ += data_bytes;
-        in_file.read(reinterpret_cast<char*>(char_counts_), sizeof(uint64_t) * 257);
-        in_file.close();
-
-        std::string prefix;
-        std::string suffix;
-        size_t loc = path.find_last_of('.');
-        if (loc == std::string::npos) {
-            prefix = path;
-            suffix = "";
+    block_rlbwt(std::string path, load_mode mode = load_mode::stream)
+        : bytes_(sizeof(block_rlbwt)),
+          alpha_(),
+          block_alpha_(),
+          mode_(mode),
+          root_map_(),
+          data_map_(),
+          arena_(),
+          pager_(),
+          kmers_(),
+          cache_(nullptr),
+          root_less_(),
+          block_less_() {
+        if (container::is_container(path)) {
+            load_container(path);
+            kmers_.load(path);
+            bytes_ += kmers_.bytes();
         } else {
-            prefix = path.substr(0, loc);
-            suffix = path.substr(loc);
-        }
-        in_file.open(prefix + "_data" + suffix, std::ios::binary | std::ios::in);
-        if (in_file.fail()) {
-            std::cerr << " -> Failed" << std::endl;
-            exit(1);
-        }
-        for (uint64_t i = 1; i <= block_count_; i++) {
-            s_blocks_.push_back(read_super_block(in_file));
+            load_legacy(path);
         }
         bytes_ += s_blocks_.size() * sizeof(super_block_type*);
-        in_file.close();
+        uint64_t row = alpha_.sigma() + 1;
+        root_less_.resize((block_count_ + 1) * row);
+        for (uint64_t s = 0; s <= block_count_; s++) {
+            reinterpret_cast<alphabet_type*>(p_sums_ + alpha_.size() * s)
+                ->less_sums(root_less_.data() + s * row, alpha_);
+        }
+        bytes_ += root_less_.size() * sizeof(uint64_t);
     }
 
     block_rlbwt() = delete;
@@ -332,7 +368,18 @@ class block_rlbwt {
         p_sums_ = std::exchange(other.p_sums_, nullptr);
         s_blocks_ =
             std::exchange(other.s_blocks_, std::vector<super_block_type*>());
+        alpha_ = std::move(other.alpha_);
+        block_alpha_ = std::move(other.block_alpha_);
+        mode_ = other.mode_;
+        root_map_ = std::move(other.root_map_);
+        data_map_ = std::move(other.data_map_);
+        arena_ = std::move(other.arena_);
+        pager_ = std::move(other.pager_);
         std::memcpy(char_counts_, other.char_counts_, sizeof(uint64_t) * 257);
+        kmers_ = std::move(other.kmers_);
+        cache_ = std::exchange(other.cache_, nullptr);
+        root_less_ = std::move(other.root_less_);
+        block_less_ = std::move(other.block_less_);
     }
 
     block_rlbwt& operator=(block_rlbwt&& other) {
@@ -341,11 +388,25 @@ class block_rlbwt {
         p_sums_ = std::exchange(other.p_sums_, nullptr);
         s_blocks_ =
             std::exchange(other.s_blocks_, std::vector<super_block_type*>());
+        alpha_ = std::move(other.alpha_);
+        block_alpha_ = std::move(other.block_alpha_);
+        mode_ = other.mode_;
+        root_map_ = std::move(other.root_map_);
+        data_map_ = std::move(other.data_map_);
+        arena_ = std::move(other.arena_);
+        pager_ = std::move(other.pager_);
         std::memcpy(char_counts_, other.char_counts_, sizeof(uint64_t) * 257);
+        kmers_ = std::move(other.kmers_);
+        cache_ = std::exchange(other.cache_, nullptr);
+        root_less_ = std::move(other.root_less_);
+        block_less_ = std::move(other.block_less_);
         return *this;
     }
 
     ~block_rlbwt() {
+        if (mode_ != load_mode::stream) {
+            return;
+        }
         for (uint64_t i = 0; i < block_count_; i++) {
             std::free(s_blocks_[i]);
         }
@@ -357,65 +418,619 @@ class block_rlbwt {
             return 0;
         }
         uint64_t s_block_i = i / SUPER_BLOCK_ELEMS;
-        return alphabet_type::revert(s_blocks_[s_block_i]->at(i % SUPER_BLOCK_ELEMS));
+        i %= SUPER_BLOCK_ELEMS;
+        return alpha_.revert(s_block(s_block_i, i)->at(i, block_alpha_));
     }
 
     uint64_t count(const std::string& pattern) const {
-        uint8_t c = pattern[pattern.size() - 1];
+        size_t m = pattern.size();
+        uint8_t c = pattern[m - 1];
         uint64_t a = char_counts_[c];
         uint64_t b = char_counts_[uint16_t(c) + 1];
-        uint64_t ret = b  - a;
-        for (size_t i = pattern.size() - 2; i < pattern.size() && ret > 0; i--) {
+        size_t i = m - 1;
+        uint64_t cached = cache_ ? cache_->find(pattern, a, b) : 0;
+        if (cached) {
+            i = m - cached;
+        } else if (kmers_.covers(m)) {
+            i = m - kmers_.k();
+            std::tie(a, b) = kmers_.find(pattern.data() + i);
+        }
+        uint64_t ret = b - a;
+        for (i--; i < m && ret > 0; i--) {
             c = pattern[i];
-            a = rank(a, c);
-            b = rank(b, c);
-            ret = b - a;
+            // Inside a single run the step is a shift of a and b, or empty.
+            auto r = run_rank(a, b, c);
+            if (!r) {
+                r = rank_pair(a, b, c);
+            }
+            ret = r->second - r->first;
             if (ret == 0) [[unlikely]] {
                 break;
             }
-            a += char_counts_[c];
-            b += char_counts_[c];
+            a = char_counts_[c] + r->first;
+            b = a + ret;
+            if (cache_ && i > 0 && interval_cache::keeps(m - i)) [[unlikely]] {
+                cache_->insert(pattern.data() + i, m - i, a, b);
+            }
+        }
+        if (cache_ && cached < m) {
+            cache_->insert(pattern.data(), m, a, a + ret);
         }
         return ret;
     }
 
+    // Number of symbols in the BWT smaller than c.
+    uint64_t C(uint8_t c) const { return char_counts_[c]; }
+
     uint64_t LF(const uint64_t& i) const {
-        uint8_t c = at(i);
-        return char_counts_[c] + rank(i, c);
+        auto r = inverse_select(i);
+        return char_counts_[r.first] + r.second;
+    }
+
+    // {at(i), rank(i, at(i))} with one block scan.
+    std::pair<uint8_t, uint64_t> inverse_select(uint64_t i) const {
+        if (i >= size_) [[unlikely]] {
+            return {0, rank(i, 0)};
+        }
+        uint64_t s_block_i = i / SUPER_BLOCK_ELEMS;
+        i %= SUPER_BLOCK_ELEMS;
+        auto r = s_block(s_block_i, i)->inverse_select(i, block_alpha_);
+        uint64_t res = reinterpret_cast<alphabet_type*>(p_sums_ + alpha_.size() * s_block_i)->p_sum(r.first, alpha_);
+        return {alpha_.revert(r.first), res + r.second};
+    }
+
+    // Position of the occurrence of c with rank k, the inverse of rank, or
+    // size() if c occurs at most k times. The super block is found by binary
+    // search over the super block partial sums.
+    uint64_t select(uint8_t c, uint64_t k) const {
+        if (k >= char_counts_[uint16_t(c) + 1] - char_counts_[c]) [[unlikely]] {
+            return size_;
+        }
+        c = alpha_.convert(c);
+        uint64_t lo = 0;
+        uint64_t hi = block_count_;
+        while (hi - lo > 1) {
+            uint64_t mid = (lo + hi) / 2;
+            if (reinterpret_cast<alphabet_type*>(p_sums_ + alpha_.size() * mid)->p_sum(c, alpha_) <= k) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        k -= reinterpret_cast<alphabet_type*>(p_sums_ + alpha_.size() * lo)->p_sum(c, alpha_);
+        uint64_t start = lo * SUPER_BLOCK_ELEMS;
+        uint64_t elems = size_ - start < SUPER_BLOCK_ELEMS ? size_ - start : SUPER_BLOCK_ELEMS;
+        return start + s_blocks_[lo]->select(c, k, (elems + cap - 1) / cap, block_alpha_,
+                                             [&](uint32_t block) { s_block(lo, uint64_t(block) * cap); });
     }
 
     uint64_t rank(uint64_t i, uint8_t c) const {
-        c = alphabet_type::convert(c);
+        c = alpha_.convert(c);
         if (i >= size_) [[unlikely]] {
-            return reinterpret_cast<alphabet_type*>(p_sums_ + alphabet_type::size() * block_count_)->p_sum(c);
+            return reinterpret_cast<alphabet_type*>(p_sums_ + alpha_.size() * block_count_)->p_sum(c, alpha_);
         }
         uint64_t s_block_i = i / SUPER_BLOCK_ELEMS;
-        uint64_t res = reinterpret_cast<alphabet_type*>(p_sums_ + alphabet_type::size() * s_block_i)->p_sum(c);
-        res += s_blocks_[s_block_i]->rank(c, i % SUPER_BLOCK_ELEMS);
+        uint64_t res = reinterpret_cast<alphabet_type*>(p_sums_ + alpha_.size() * s_block_i)->p_sum(c, alpha_);
+        i %= SUPER_BLOCK_ELEMS;
+        res += s_block(s_block_i, i)->rank(c, i, block_alpha_);
         return res;
     }
 
+    // Number of symbols smaller than c in BWT[0, i). The block partial sums
+    // of the symbols smaller than c are added up unless build_less_sums has
+    // been called.
+    uint64_t rank_less(uint64_t i, uint8_t c) const {
+        if (i >= size_) [[unlikely]] {
+            return char_counts_[c];
+        }
+        uint32_t less[256];
+        block_alpha_.less_masks(c, less);
+        uint64_t s_block_i = i / SUPER_BLOCK_ELEMS;
+        uint64_t res = root_less_[s_block_i * (alpha_.sigma() + 1) + alpha_.less_count(c)];
+        const uint32_t* sums = nullptr;
+        if (block_less_.size()) {
+            sums = block_less_.data() +
+                   s_block_i * super_block_type::blocks * (block_alpha_.sigma() + 1);
+        }
+        i %= SUPER_BLOCK_ELEMS;
+        return res + s_block(s_block_i, i)->rank_less(c, i, less, sums, block_alpha_);
+    }
+
+    // {rank(a, c), rank(b, c)} for a <= b.
+    std::pair<uint64_t, uint64_t> rank_pair(uint64_t a, uint64_t b, uint8_t c) const {
+        uint64_t s_block_i = a / SUPER_BLOCK_ELEMS;
+        if (b >= size_ || b / SUPER_BLOCK_ELEMS != s_block_i) [[unlikely]] {
+            return {rank(a, c), rank(b, c)};
+        }
+        c = alpha_.convert(c);
+        uint64_t res = reinterpret_cast<alphabet_type*>(p_sums_ + alpha_.size() * s_block_i)->p_sum(c, alpha_);
+        a %= SUPER_BLOCK_ELEMS;
+        b %= SUPER_BLOCK_ELEMS;
+        // a and b may be in different page groups.
+        s_block(s_block_i, b);
+        auto r = s_block(s_block_i, a)->rank_pair(c, a, b, block_alpha_);
+        return {res + r.first, res + r.second};
+    }
+
+    // out[k] = rank(i, symbol(k)) for k < sigma().
+    void rank_all(uint64_t i, uint64_t* out) const {
+        std::fill_n(out, alpha_.sigma(), 0);
+        if (i >= size_) [[unlikely]] {
+            reinterpret_cast<alphabet_type*>(p_sums_ + alpha_.size() * block_count_)->add_p_sums(out, alpha_);
+            return;
+        }
+        uint64_t s_block_i = i / SUPER_BLOCK_ELEMS;
+        reinterpret_cast<alphabet_type*>(p_sums_ + alpha_.size() * s_block_i)->add_p_sums(out, alpha_);
+        i %= SUPER_BLOCK_ELEMS;
+        s_block(s_block_i, i)->rank_all(i, out, block_alpha_);
+    }
+
+    // Distinct symbols of BWT[a, b) for a <= b, in increasing order, with
+    // their ranks at both ends: syms[j] occurs in [a, b), ra[j] = rank(a,
+    // syms[j]) and rb[j] = rank(b, syms[j]) for j less than the returned
+    // count. The arrays need room for sigma() entries. If a and b are in the
+    // same block it is scanned once, otherwise the blocks in between are
+    // skipped with partial sums.
+    uint16_t interval_symbols(uint64_t a, uint64_t b, uint8_t* syms, uint64_t* ra,
+                              uint64_t* rb) const {
+        if (a >= b) [[unlikely]] {
+            return 0;
+        }
+        uint64_t all_a[256];
+        uint64_t all_b[256];
+        uint64_t s_block_i = a / SUPER_BLOCK_ELEMS;
+        if (b >= size_ || b / SUPER_BLOCK_ELEMS != s_block_i) [[unlikely]] {
+            rank_all(a, all_a);
+            rank_all(b, all_b);
+        } else {
+            std::fill_n(all_a, alpha_.sigma(), 0);
+            std::fill_n(all_b, alpha_.sigma(), 0);
+            const alphabet_type* alpha =
+                reinterpret_cast<alphabet_type*>(p_sums_ + alpha_.size() * s_block_i);
+            alpha->add_p_sums(all_a, alpha_);
+            alpha->add_p_sums(all_b, alpha_);
+            a %= SUPER_BLOCK_ELEMS;
+            b %= SUPER_BLOCK_ELEMS;
+            s_block(s_block_i, b);
+            s_block(s_block_i, a)->rank_all_pair(a, b, all_a, all_b, block_alpha_);
+        }
+        return symbols_between(all_a, all_b, syms, ra, rb);
+    }
+
+    // out[k] = rank(pos[k], syms[k]) for k < n.
+    //
+    // Queries are run in groups of RANK_GROUP. Each of the memory accesses of
+    // rank (partial sums, block offset, block) is prefetched for the whole
+    // group before the next one is issued, so the cache misses of independent
+    // queries overlap instead of being paid one after the other.
+    void rank_batch(const uint64_t* pos, const uint8_t* syms, uint64_t* out, size_t n) const {
+        for (size_t g = 0; g < n; g += RANK_GROUP) {
+            size_t e = g + RANK_GROUP < n ? g + RANK_GROUP : n;
+            for (size_t k = g; k < e; k++) {
+                prefetch_offset(pos[k]);
+            }
+            for (size_t k = g; k < e; k++) {
+                prefetch_block(pos[k]);
+            }
+            for (size_t k = g; k < e; k++) {
+                out[k] = rank(pos[k], syms[k]);
+            }
+        }
+    }
+
+    // out[k] = rank_pair(a[k], b[k], syms[k]) for k < n. Both ends are
+    // prefetched in groups of RANK_GROUP like in rank_batch.
+    void rank_pair_batch(const uint64_t* a, const uint64_t* b, const uint8_t* syms,
+                         std::pair<uint64_t, uint64_t>* out, size_t n) const {
+        for (size_t g = 0; g < n; g += RANK_GROUP) {
+            size_t e = g + RANK_GROUP < n ? g + RANK_GROUP : n;
+            for (size_t k = g; k < e; k++) {
+                prefetch_offset(a[k]);
+                prefetch_offset(b[k]);
+            }
+            for (size_t k = g; k < e; k++) {
+                prefetch_block(a[k]);
+                prefetch_block(b[k]);
+            }
+            for (size_t k = g; k < e; k++) {
+                out[k] = rank_pair(a[k], b[k], syms[k]);
+            }
+        }
+    }
+
+    // rows[k] = LF(rows[k]) for k < n, with the symbol at the old row written
+    // to syms[k]. Prefetched in groups of RANK_GROUP like rank_batch.
+    void LF_batch(uint64_t* rows, uint8_t* syms, size_t n) const {
+        for (size_t g = 0; g < n; g += RANK_GROUP) {
+            size_t e = g + RANK_GROUP < n ? g + RANK_GROUP : n;
+            for (size_t k = g; k < e; k++) {
+                prefetch_offset(rows[k]);
+            }
+            for (size_t k = g; k < e; k++) {
+                prefetch_block(rows[k]);
+            }
+            for (size_t k = g; k < e; k++) {
+                auto r = inverse_select(rows[k]);
+                syms[k] = r.first;
+                rows[k] = char_counts_[r.first] + r.second;
+            }
+        }
+    }
+
+    // out[k] = count(patterns[k]) for k < n.
+    //
+    // Up to COUNT_WINDOW backward searches are kept in flight. Each round
+    // prefetches the block offsets and then the blocks for the next step of
+    // every active search before any of the steps are taken. Searches that
+    // finish or reach an empty range are replaced by the next pattern.
+    void count_many(const std::string* patterns, uint64_t* out, size_t n) const {
+        search w[COUNT_WINDOW];
+        size_t active = 0;
+        size_t next = 0;
+        while (true) {
+            while (active < COUNT_WINDOW && next < n) {
+                if (start_search(patterns, next, out, w[active])) {
+                    active++;
+                }
+                next++;
+            }
+            if (active == 0) {
+                break;
+            }
+            for (size_t k = 0; k < active; k++) {
+                prefetch_offset(w[k].a);
+                prefetch_offset(w[k].b);
+            }
+            for (size_t k = 0; k < active; k++) {
+                prefetch_block(w[k].a);
+                prefetch_block(w[k].b);
+            }
+            for (size_t k = 0; k < active;) {
+                search& s = w[k];
+                uint8_t c = patterns[s.p][s.i];
+                std::tie(s.a, s.b) = rank_pair(s.a, s.b, c);
+                s.a += char_counts_[c];
+                s.b += char_counts_[c];
+                if (s.a == s.b || s.i == 0) {
+                    out[s.p] = s.b - s.a;
+                    s = w[--active];
+                } else {
+                    s.i--;
+                    k++;
+                }
+            }
+        }
+    }
+
     uint8_t operator[](size_t i) const {
         return at(i);
     }
 
     uint64_t size() const { return size_; }
     uint64_t bytes() const { return bytes_; }
+    // Number of distinct symbols, and the symbol with index k < sigma() in
+    // rank_all results. Symbols are ordered by increasing frequency.
+    uint16_t sigma() const { return alpha_.sigma(); }
+    uint8_t symbol(uint16_t k) const { return alpha_.revert(k); }
+
+    // Replaces the k-mer table of the index with one for k-mers, so that count
+    // starts at step k. k = 0 drops the table.
+    void build_kmers(uint16_t k) {
+        bytes_ -= kmers_.bytes();
+        kmers_ = k ? kmer_table::build(*this, k) : kmer_table();
+        bytes_ += kmers_.bytes();
+    }
+
+    const kmer_table& kmers() const { return kmers_; }
+
+    // Stores the block partial sums in symbol order, so that rank_less reads
+    // one value per block instead of adding up the partial sums of the
+    // symbols smaller than c. Takes 4 * (sigma() + 1) bytes per block.
+    void build_less_sums() {
+        uint64_t row = block_alpha_.sigma() + 1;
+        uint64_t blocks = (size_ + cap - 1) / cap;
+        bytes_ -= block_less_.size() * sizeof(uint32_t);
+        block_less_.resize(blocks * row);
+        for (uint64_t b = 0; b < blocks; b++) {
+            uint64_t s_block_i = b / super_block_type::blocks;
+            uint64_t i = b % super_block_type::blocks;
+            s_block(s_block_i, i * cap)->less_sums(i, block_less_.data() + b * row, block_alpha_);
+        }
+        bytes_ += block_less_.size() * sizeof(uint32_t);
+    }
+
+    // Makes count look up and store suffix ranges in cache, or stop using a
+    // cache if cache is null. The cache may be shared by threads querying this
+    // index, but not with other indexes.
+    void set_cache(interval_cache* cache) { cache_ = cache; }
+    page_backing backing() const { return arena_.backing(); }
+
+    // Max bytes of block data kept in memory in paged mode, 0 for no limit.
+    void set_page_budget(uint64_t bytes) {
+        if (pager_) {
+            pager_->set_budget(bytes);
+        }
+    }
+
+    const pager* paging() const { return pager_.get(); }
 
     void print() const {
         for (uint32_t i = 0; i < block_count_; i++) {
             uint64_t s = (i + 1) * SUPER_BLOCK_ELEMS;
             s = s > size_ ? size_ % SUPER_BLOCK_ELEMS : SUPER_BLOCK_ELEMS;
             std::cerr << "S block " << i << ":" << std::endl;
-            reinterpret_cast<alphabet_type*>(p_sums_ * alphabet_type::size() * i)->print();
-            s_blocks_[i]->print(s);
+            reinterpret_cast<alphabet_type*>(p_sums_ + alpha_.size() * i)->print(alpha_);
+            s_blocks_[i]->print(s, block_alpha_);
         }
     }
 
    private:
-    super_block_type* read_super_block(std::fstream& in_file) {
-        uint64_t in_bytes = 0;
-        in_file.read(reinterpret_cast<char*>(&in_bytes), sizeof(uint64_t));
+    // Compacts rank_all results at both ends of an interval to the symbols
+    // occurring in it, in increasing order of symbol.
+    uint16_t symbols_between(const uint64_t* all_a, const uint64_t* all_b, uint8_t* syms,
+                             uint64_t* ra, uint64_t* rb) const {
+        uint16_t n = 0;
+        for (uint16_t k = 0; k < alpha_.sigma(); k++) {
+            if (all_a[k] == all_b[k]) {
+                continue;
+            }
+            uint8_t c = alpha_.revert(k);
+            uint16_t j = n++;
+            for (; j > 0 && syms[j - 1] > c; j--) {
+                syms[j] = syms[j - 1];
+                ra[j] = ra[j - 1];
+                rb[j] = rb[j - 1];
+            }
+            syms[j] = c;
+            ra[j] = all_a[k];
+            rb[j] = all_b[k];
+        }
+        return n;
+    }
+
+    // State of a backward search in count_many. [a, b) is the range matching
+    // the suffix of pattern p after position i.
+    struct search {
+        size_t p;
+        size_t i;
+        uint64_t a;
+        uint64_t b;
+    };
+
+    // Starts the search for pattern p. Returns false if the search is done after
+    // the first symbol, with the result written to out.
+    bool start_search(const std::string* patterns, size_t p, uint64_t* out, search& s) const {
+        const std::string& pattern = patterns[p];
+        if (pattern.size() == 0) [[unlikely]] {
+            out[p] = size_;
+            return false;
+        }
+        uint8_t c = pattern[pattern.size() - 1];
+        s = {p, pattern.size() - 1, char_counts_[c], char_counts_[uint16_t(c) + 1]};
+        if (kmers_.covers(pattern.size())) {
+            s.i = pattern.size() - kmers_.k();
+            std::tie(s.a, s.b) = kmers_.find(pattern.data() + s.i);
+        }
+        if (s.a == s.b || s.i == 0) {
+            out[p] = s.b - s.a;
+            return false;
+        }
+        s.i--;
+        return true;
+    }
+
+    // rank_pair(a, b, c) for a < b if both are in the same block, or if
+    // [a, b) lies inside one run of the block of a. Empty ranges are returned
+    // without reading partial sums.
+    std::optional<std::pair<uint64_t, uint64_t>> run_rank(uint64_t a, uint64_t b, uint8_t c) const {
+        // The last block may end before its capacity, so b = size() would
+        // be scanned for past the last run.
+        if (b >= size_) [[unlikely]] {
+            return std::nullopt;
+        }
+        uint64_t s_block_i = a / SUPER_BLOCK_ELEMS;
+        uint64_t start = s_block_i * SUPER_BLOCK_ELEMS;
+        c = alpha_.convert(c);
+        auto r = s_block(s_block_i, a - start)->run_rank(c, a - start, b - start, block_alpha_);
+        if (!r) {
+            return std::nullopt;
+        }
+        if (r->first == r->second) {
+            return std::pair<uint64_t, uint64_t>(0, 0);
+        }
+        uint64_t res = reinterpret_cast<alphabet_type*>(p_sums_ + alpha_.size() * s_block_i)->p_sum(c, alpha_);
+        return std::pair<uint64_t, uint64_t>(res + r->first, res + r->second);
+    }
+
+    void prefetch_offset(uint64_t i) const {
+        if (i >= size_) [[unlikely]] {
+            return;
+        }
+        uint64_t s_block_i = i / SUPER_BLOCK_ELEMS;
+        __builtin_prefetch(p_sums_ + alpha_.size() * s_block_i);
+        i %= SUPER_BLOCK_ELEMS;
+        s_block(s_block_i, i)->prefetch_offset(i);
+    }
+
+    void prefetch_block(uint64_t i) const {
+        if (i >= size_) [[unlikely]] {
+            return;
+        }
+        s_blocks_[i / SUPER_BLOCK_ELEMS]->prefetch_block(i % SUPER_BLOCK_ELEMS, block_alpha_);
+    }
+
+    const super_block_type* s_block(uint64_t s_block_i, uint64_t i) const {
+        if (pager_) {
+            pager_->touch(s_block_i * PAGE_GROUPS + i / (cap * PAGE_GROUP));
+        }
+        return s_blocks_[s_block_i];
+    }
+
+    // Page units are groups of PAGE_GROUP blocks, with the block partial sums
+    // in front of them. Super block headers (block offsets) stay resident.
+    void start_pager(const std::vector<uint64_t>& ends) {
+        std::vector<std::pair<uint64_t, uint64_t>> units;
+        const uint8_t* base = data_map_.data();
+        for (uint64_t s = 0; s < block_count_; s++) {
+            const super_block_type* sb = s_blocks_[s];
+            uint64_t data = reinterpret_cast<const uint8_t*>(sb) + sizeof(super_block_type) - base;
+            for (uint64_t g = 0; g < PAGE_GROUPS; g++) {
+                uint64_t first = g * PAGE_GROUP;
+                uint64_t next = first + PAGE_GROUP;
+                if (first > 0 && sb->block_offset(first) == 0) {
+                    units.push_back({0, 0});
+                    continue;
+                }
+                uint64_t start = data + sb->block_offset(first) - block_alpha_.size();
+                uint64_t end = ends[s];
+                if (next < super_block_type::blocks && sb->block_offset(next) != 0) {
+                    end = data + sb->block_offset(next) - block_alpha_.size();
+                }
+                units.push_back({start, end - start});
+            }
+        }
+        pager_ = std::make_unique<pager>(data_map_.data(), std::move(units));
+    }
+
+    void load_container(const std::string& path) {
+        container c(path, kind, block_type::encoding, block_type::cap);
+        size_ = c.elems();
+        block_count_ = c.blocks();
+        std::fstream in_file;
+        in_file.open(path, std::ios::binary | std::ios::in);
+        c.seek(in_file, section::statics);
+        bytes_ += alpha_.load_statics(in_file);
+        bytes_ += block_alpha_.load_statics(in_file);
+        bytes_ += super_block_type::load_statics(in_file);
+        bytes_ += block_type::load_statics(in_file);
+        c.seek(in_file, section::char_counts);
+        in_file.read(reinterpret_cast<char*>(char_counts_), sizeof(uint64_t) * 257);
+        std::vector<uint64_t> directory(block_count_ + 1);
+        c.seek(in_file, section::directory);
+        in_file.read(reinterpret_cast<char*>(directory.data()),
+                     sizeof(uint64_t) * directory.size());
+        const section_entry& p_sums = c.get(section::p_sums);
+        const section_entry& blocks = c.get(section::block_data);
+        bytes_ += p_sums.size;
+        if (mode_ == load_mode::mmap || mode_ == load_mode::paged) {
+            in_file.close();
+            data_map_ = mapped_file(path, block_type::padding_bytes, MADV_RANDOM);
+            data_map_.advise(p_sums.offset, p_sums.size, MADV_WILLNEED);
+            p_sums_ = data_map_.data() + p_sums.offset;
+            for (uint64_t i = 0; i < block_count_; i++) {
+                s_blocks_.push_back(reinterpret_cast<super_block_type*>(
+                    data_map_.data() + blocks.offset + directory[i]));
+            }
+            bytes_ += blocks.size;
+            if (mode_ == load_mode::paged) {
+                std::vector<uint64_t> ends;
+                for (uint64_t i = 1; i <= block_count_; i++) {
+                    ends.push_back(blocks.offset + directory[i]);
+                }
+                start_pager(ends);
+            }
+            return;
+        }
+        if (mode_ == load_mode::parallel || mode_ == load_mode::huge) {
+            arena_ = arena(p_sums.size + blocks.size + block_type::padding_bytes + 128,
+                           mode_ == load_mode::huge);
+            p_sums_ = arena_.alloc(p_sums.size);
+            c.seek(in_file, section::p_sums);
+            in_file.read(reinterpret_cast<char*>(p_sums_), p_sums.size);
+            in_file.close();
+            uint8_t* data = arena_.alloc(blocks.size + block_type::padding_bytes);
+            parallel_reader(path).read(data, blocks.offset, blocks.size);
+            for (uint64_t i = 0; i < block_count_; i++) {
+                s_blocks_.push_back(reinterpret_cast<super_block_type*>(data + directory[i]));
+            }
+            bytes_ += blocks.size;
+            return;
+        }
+        p_sums_ = (uint8_t*)std::malloc(p_sums.size);
+        c.seek(in_file, section::p_sums);
+        in_file.read(reinterpret_cast<char*>(p_sums_), p_sums.size);
+        c.seek(in_file, section::block_data);
+        for (uint64_t i = 0; i < block_count_; i++) {
+            s_blocks_.push_back(read_super_block(in_file, directory[i + 1] - directory[i]));
+        }
+        in_file.close();
+    }
+
+    // Two file format with root and "_data" file, from before containers.
+    void load_legacy(const std::string& path) {
+        std::fstream in_file;
+        in_file.open(path, std::ios::binary | std::ios::in);
+        if (in_file.fail()) {
+            std::cerr << " -> Failed" << std::endl;
+            exit(1);
+        }
+        bytes_ += alpha_.load_statics(in_file);
+        bytes_ += block_alpha_.load_statics(in_file);
+        bytes_ += super_block_type::load_statics(in_file);
+        bytes_ += block_type::load_statics(in_file);
+        uint64_t data_bytes;
+        in_file.read(reinterpret_cast<char*>(&data_bytes), sizeof(uint64_t));
+        in_file.read(reinterpret_cast<char*>(&size_), sizeof(uint64_t));
+        in_file.read(reinterpret_cast<char*>(&block_count_), sizeof(uint64_t));
+#ifdef VERB
+        std::cerr << data_bytes << " bytes of data\n"
+                  << size_ << " logical elements\n"
+                  << "in " << block_count_ << " super blocks" << std::endl;
+#endif
+        std::string prefix;
+        std::string suffix;
+        size_t loc = path.find_last_of('.');
+        if (loc == std::string::npos) {
+            prefix = path;
+            suffix = "";
+        } else {
+            prefix = path.substr(0, loc);
+            suffix = path.substr(loc);
+        }
+        if (mode_ == load_mode::parallel || mode_ == load_mode::huge) {
+            parallel_reader reader(prefix + "_data" + suffix);
+            arena_ = arena(data_bytes + reader.size() + block_type::padding_bytes + 128,
+                           mode_ == load_mode::huge);
+            p_sums_ = arena_.alloc(data_bytes);
+            in_file.read(reinterpret_cast<char*>(p_sums_), data_bytes);
+            bytes_ += data_bytes;
+            in_file.read(reinterpret_cast<char*>(char_counts_), sizeof(uint64_t) * 257);
+            in_file.close();
+            read_super_blocks_parallel(reader);
+            return;
+        }
+        if (mode_ == load_mode::mmap || mode_ == load_mode::paged) {
+            uint64_t p_sums_offset = in_file.tellg();
+            in_file.seekg(data_bytes, std::ios::cur);
+            root_map_ = mapped_file(path);
+            root_map_.advise(p_sums_offset, data_bytes, MADV_WILLNEED);
+            p_sums_ = root_map_.data() + p_sums_offset;
+        } else {
+            p_sums_ = (uint8_t*)std::malloc(data_bytes);
+            in_file.read(reinterpret_cast<char*>(p_sums_), data_bytes);
+        }
+        bytes_ += data_bytes;
+        in_file.read(reinterpret_cast<char*>(char_counts_), sizeof(uint64_t) * 257);
+        in_file.close();
+
+        if (mode_ == load_mode::mmap || mode_ == load_mode::paged) {
+            map_super_blocks(prefix + "_data" + suffix);
+        } else {
+            in_file.open(prefix + "_data" + suffix, std::ios::binary | std::ios::in);
+            if (in_file.fail()) {
+                std::cerr << " -> Failed" << std::endl;
+                exit(1);
+            }
+            for (uint64_t i = 1; i <= block_count_; i++) {
+                uint64_t in_bytes = 0;
+                in_file.read(reinterpret_cast<char*>(&in_bytes), sizeof(uint64_t));
+                s_blocks_.push_back(read_super_block(in_file, in_bytes));
+            }
+            in_file.close();
+        }
+    }
+
+    super_block_type* read_super_block(std::fstream& in_file, uint64_t in_bytes) {
         uint8_t* data = (uint8_t*)std::malloc(in_bytes + block_type::padding_bytes);
         if constexpr (block_type::padding_bytes) {
             std::memset(data + in_bytes, 0, block_type::padding_bytes);
@@ -424,5 +1039,43 @@ class block_rlbwt {
         bytes_ += in_bytes;
         return reinterpret_cast<super_block_type*>(data);
     }
+
+    // Collect offsets from the size prefixes, then read all super blocks to
+    // one arena in parallel.
+    void read_super_blocks_parallel(const parallel_reader& reader) {
+        std::vector<uint64_t> offsets;
+        uint64_t offset = 0;
+        for (uint64_t i = 1; i <= block_count_; i++) {
+            uint64_t in_bytes;
+            reader.read(reinterpret_cast<uint8_t*>(&in_bytes), offset, sizeof(uint64_t));
+            offset += sizeof(uint64_t);
+            offsets.push_back(offset);
+            offset += in_bytes;
+            bytes_ += in_bytes;
+        }
+        uint8_t* data = arena_.alloc(offset + block_type::padding_bytes);
+        reader.read(data, 0, offset);
+        for (uint64_t o : offsets) {
+            s_blocks_.push_back(reinterpret_cast<super_block_type*>(data + o));
+        }
+    }
+
+    void map_super_blocks(const std::string& data_path) {
+        data_map_ = mapped_file(data_path, block_type::padding_bytes, MADV_RANDOM);
+        uint64_t offset = 0;
+        std::vector<uint64_t> ends;
+        for (uint64_t i = 1; i <= block_count_; i++) {
+            uint64_t in_bytes;
+            std::memcpy(&in_bytes, data_map_.data() + offset, sizeof(uint64_t));
+            offset += sizeof(uint64_t);
+            s_blocks_.push_back(reinterpret_cast<super_block_type*>(data_map_.data() + offset));
+            offset += in_bytes;
+            bytes_ += in_bytes;
+            ends.push_back(offset);
+        }
+        if (mode_ == load_mode::paged) {
+            start_pager(ends);
+        }
+    }
 };
 }  // namespace bbwt
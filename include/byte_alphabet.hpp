@@ -4,10 +4,13 @@
 #include <cstring>
 #include <cstdint>
 
+#include "alphabet_meta.hpp"
+
 namespace bbwt {
 template <class dtype>
 class byte_alphabet {
   public:
+    typedef static_meta<byte_alphabet> meta_type;
     static const constexpr uint8_t width = 8;
     static constexpr uint8_t convert(uint8_t c) {
         return c;
@@ -44,17 +47,19 @@ class byte_alphabet {
         std::memset(counts_, 0, sizeof(dtype) * A_SIZE);
     }
 
-    dtype p_sum(uint8_t c) const {
+    dtype p_sum(uint8_t c, const meta_type& = meta_type()) const {
         return counts_[c];
     }
 
-    void print() const {
+    void print(const meta_type& = meta_type()) const {
         for (uint16_t i = 0; i < 256; i++) {
             std::cerr << i << ": " << counts_[i] << std::endl;
         }
     }
 
-    static void write_statics(std::fstream&) {return; }
-    static uint64_t load_statics(std::fstream&) {return 0; }
+    template <class o_t>
+    static void write_statics(o_t&) {return; }
+    template <class i_t>
+    static uint64_t load_statics(i_t&) {return 0; }
 };
 } // namespace bbwt
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <utility>
 #include <cstdint>
+#include <optional>
 
 //#define VERB
 
@@ -12,8 +14,10 @@ template <uint32_t block_size, class alphabet_type_>
 class byte_block {
    public:
     typedef alphabet_type_ alphabet_type;
+    typedef typename alphabet_type::meta_type meta_type;
     static const constexpr bool has_members = false;
     static const constexpr uint32_t cap = block_size;
+    static const constexpr uint32_t encoding = 2;
     static const constexpr uint32_t scratch_blocks = 2;
     static const constexpr uint32_t min_size = 5;
     static const constexpr uint32_t padding_bytes = 0;
@@ -35,8 +39,9 @@ class byte_block {
     byte_block& operator=(byte_block&& other) = delete;
     byte_block& operator=(const byte_block&) = delete;
 
-    uint32_t append(uint8_t head, uint32_t length, uint8_t** scratch) {
-        const uint8_t SHIFT = 8 - alphabet_type::width;
+    uint32_t append(uint8_t head, uint32_t length, uint8_t** scratch,
+                    const meta_type& m) {
+        const uint8_t SHIFT = 8 - m.width;
         const uint8_t BYTE_MASK = SHIFT > 0 ? (uint8_t(1) << (SHIFT - 1)) - 1 : 0;
         #ifdef VERB
         std::cerr << "append(" << head << ", " << length << ")" << std::endl;
@@ -51,7 +56,7 @@ class byte_block {
         #ifdef VERB
         std::cerr << "head as written = " << std::bitset<8>(data[offset[0]]) << std::endl;
         #endif
-        if (alphabet_type::width < 7) {
+        if (m.width < 7) {
             if (length <= BYTE_MASK) {
                 data[offset[0]++] |= length;
                 return offset[0];
@@ -62,19 +67,19 @@ class byte_block {
                 std::cerr << "with continuation = " << std::bitset<8>(data[offset[0] - 1]) << std::endl;
                 #endif
             }
-        } else if (alphabet_type::width == 7) {
+        } else if (m.width == 7) {
             if (length == 1) {
                 data[offset[0]++] |= length;
                 return offset[0];
             }
-        } if (alphabet_type::width == 8) {
+        } if (m.width == 8) {
             offset[0]++;
             if constexpr (block_size <= uint32_t(1) << 8) {
                 data[offset[0]++] = length;
                 return offset[0];
             }
         }
-        if constexpr (block_size <= uint32_t(1) << (8 + SHIFT - 1)) {
+        if (block_size <= uint32_t(1) << (8 + SHIFT - 1)) {
             data[offset[0]++] = length;
             return offset[0];
         }
@@ -90,14 +95,14 @@ class byte_block {
         std::cerr << "first full byte = " << std::bitset<8>(data[offset[0] - 1]) << std::endl;
         #endif
         length >>= 7;
-        if ((block_size <= uint32_t(1) << (15)) && (alphabet_type::width == 8)) {
+        if ((block_size <= uint32_t(1) << (15)) && (m.width == 8)) {
             data[offset[0]++] = length;
             #ifdef VERB
             std::cerr << "8: rest (" << length << ") fit in third word = " << std::bitset<8>(data[offset[0] - 1]) << std::endl;
             #endif
             return offset[0];
         }
-        if constexpr (block_size <= uint32_t(1) << (15 + SHIFT - 1)) {
+        if (block_size <= uint32_t(1) << (15 + SHIFT - 1)) {
             data[offset[0]++] = length;
             #ifdef VERB
             std::cerr << "rest (" << length << ") fit in third word = " << std::bitset<8>(data[offset[0] - 1]) << std::endl;
@@ -114,12 +119,12 @@ class byte_block {
         return offset[0];
     }
 
-    uint8_t at(uint32_t location) const {
+    uint8_t at(uint32_t location, const meta_type& m) const {
         uint32_t i = 0;
         while (true) {
             uint8_t c;
             uint32_t rl;
-            read(i, c, rl);
+            read(i, c, rl, m);
             rl++;
             if (location >= rl) {
                 location -= rl;
@@ -129,7 +134,7 @@ class byte_block {
         }
     }
 
-    uint32_t rank(uint8_t c, uint32_t location) const {
+    uint32_t rank(uint8_t c, uint32_t location, const meta_type& m) const {
         #ifdef VERB
         std::cerr << "rank(" << c << ", " << location << ")" << std::endl;
         #endif
@@ -139,10 +144,10 @@ class byte_block {
         while (true) {
             uint8_t current;
             uint32_t rl;
-            read(i, current, rl);
+            read(i, current, rl, m);
             rl++;
             #ifdef VERB
-            std::cerr << " run " << alphabet_type::revert(current) << ", " << rl << std::endl;
+            std::cerr << " run " << m.revert(current) << ", " << rl << std::endl;
             #endif
             if (location >= rl) [[likely]] {
                 location -= rl;
@@ -154,6 +159,165 @@ class byte_block {
         }
     }
 
+    // Number of symbols before location that are smaller than some symbol.
+    // Run lengths are masked with less, see meta_type::less_masks.
+    uint32_t rank_less(const uint32_t* less, uint32_t location, const meta_type& m) const {
+        uint32_t res = 0;
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current;
+            uint32_t rl;
+            read(i, current, rl, m);
+            rl++;
+            if (location >= rl) [[likely]] {
+                location -= rl;
+                res += rl & less[current];
+            } else {
+                res += location & less[current];
+                return res;
+            }
+        }
+    }
+
+    // {at(location, m), rank(at(location, m), location, m)} with one scan.
+    std::pair<uint8_t, uint32_t> inverse_select(uint32_t location, const meta_type& m) const {
+        uint32_t counts[256];
+        std::fill_n(counts, uint16_t(1) << m.width, 0);
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current;
+            uint32_t rl;
+            read(i, current, rl, m);
+            rl++;
+            if (location >= rl) [[likely]] {
+                location -= rl;
+                counts[current] += rl;
+            } else {
+                return {current, counts[current] + location};
+            }
+        }
+    }
+
+    // Adds the number of occurrences of each symbol before location to out.
+    void rank_all(uint32_t location, uint64_t* out, const meta_type& m) const {
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current;
+            uint32_t rl;
+            read(i, current, rl, m);
+            rl++;
+            if (location >= rl) [[likely]] {
+                location -= rl;
+                out[current] += rl;
+            } else {
+                out[current] += location;
+                return;
+            }
+        }
+    }
+
+    // Adds the number of occurrences of each symbol before a to ra and before
+    // b to rb, for a <= b, with one scan.
+    void rank_all_pair(uint32_t a, uint32_t b, uint64_t* ra, uint64_t* rb,
+                       const meta_type& m) const {
+        uint32_t i = 0;
+        uint8_t current;
+        uint32_t rl;
+        while (true) {
+            read(i, current, rl, m);
+            rl++;
+            if (a >= rl) [[likely]] {
+                a -= rl;
+                b -= rl;
+                ra[current] += rl;
+                rb[current] += rl;
+            } else {
+                break;
+            }
+        }
+        ra[current] += a;
+        while (b >= rl) {
+            b -= rl;
+            rb[current] += rl;
+            read(i, current, rl, m);
+            rl++;
+        }
+        rb[current] += b;
+    }
+
+    // {rank(c, a, m), rank(c, b, m)} with a scan to a only, if [a, b) lies
+    // inside one run of the block. Otherwise b may be past the end of the block.
+    std::optional<std::pair<uint32_t, uint32_t>> run_rank(uint8_t c, uint32_t a, uint32_t b,
+                                                          const meta_type& m) const {
+        uint32_t res = 0;
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current;
+            uint32_t rl;
+            read(i, current, rl, m);
+            rl++;
+            if (a >= rl) [[likely]] {
+                a -= rl;
+                b -= rl;
+                res += current == c ? rl : 0;
+            } else if (b > rl) {
+                return std::nullopt;
+            } else if (current == c) {
+                return std::pair<uint32_t, uint32_t>(res + a, res + b);
+            } else {
+                return std::pair<uint32_t, uint32_t>(res, res);
+            }
+        }
+    }
+
+    // {rank(c, a, m), rank(c, b, m)} for a <= b, with one scan.
+    std::pair<uint32_t, uint32_t> rank_pair(uint8_t c, uint32_t a, uint32_t b,
+                                            const meta_type& m) const {
+        uint32_t res = 0;
+        uint32_t i = 0;
+        uint8_t current;
+        uint32_t rl;
+        while (true) {
+            read(i, current, rl, m);
+            rl++;
+            if (a >= rl) [[likely]] {
+                a -= rl;
+                b -= rl;
+                res += current == c ? rl : 0;
+            } else {
+                break;
+            }
+        }
+        uint32_t res_a = res + (current == c ? a : 0);
+        while (b >= rl) {
+            b -= rl;
+            res += current == c ? rl : 0;
+            read(i, current, rl, m);
+            rl++;
+        }
+        return {res_a, res + (current == c ? b : 0)};
+    }
+
+    // Position of the occurrence of c with rank k, the inverse of rank. The
+    // block has to contain more than k occurrences of c.
+    uint32_t select(uint8_t c, uint32_t k, const meta_type& m) const {
+        uint32_t location = 0;
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current;
+            uint32_t rl;
+            read(i, current, rl, m);
+            rl++;
+            if (current == c) {
+                if (k < rl) {
+                    return location + k;
+                }
+                k -= rl;
+            }
+            location += rl;
+        }
+    }
+
     uint64_t commit(uint8_t** scratch) {
         uint64_t* bytes = reinterpret_cast<uint64_t*>(scratch[0]);
         uint8_t* data = reinterpret_cast<uint8_t*>(this);
@@ -172,17 +336,19 @@ class byte_block {
     }
 
     void clear() {}
-    static void write_statics(std::fstream&) {return; }
-    static uint64_t load_statics(std::fstream&) {return 0; }
+    template <class o_t>
+    static void write_statics(o_t&) {return; }
+    template <class i_t>
+    static uint64_t load_statics(i_t&) {return 0; }
 
-    void print(uint32_t sb) const {
+    void print(uint32_t sb, const meta_type& m) const {
         uint32_t i = 0;
         while (true) {
             uint8_t current;
             uint32_t rl;
-            read(i, current, rl);
+            read(i, current, rl, m);
             rl++;
-            std::cerr << " run " << alphabet_type::revert(current) << ", " << rl << std::endl;
+            std::cerr << " run " << m.revert(current) << ", " << rl << std::endl;
             if (sb > rl) [[likely]] {
                 sb -= rl;
             } else {
@@ -192,15 +358,18 @@ class byte_block {
     }
 
    private:
-    inline void read(uint32_t& i, uint8_t& c, uint32_t& rl) const {
-        const uint8_t SHIFT = 8 - alphabet_type::width;
+    // read and get are forced inline, as GCC stops inlining them into the
+    // scans once there are a few of them.
+    __attribute__((always_inline)) inline void read(uint32_t& i, uint8_t& c, uint32_t& rl,
+                                                    const meta_type& m) const {
+        const uint8_t SHIFT = 8 - m.width;
         const uint8_t BYTE_MASK = SHIFT > 0 ? (uint8_t(1) << (SHIFT - 1)) - 1 : 0;
         const uint8_t* data = reinterpret_cast<const uint8_t*>(this);
-        if (alphabet_type::width == 8) {
+        if (m.width == 8) {
             c = data[i++];
             rl = 0;
             return get(i, rl, 0);
-        } else if (alphabet_type::width == 7) {
+        } else if (m.width == 7) {
             c = data[i] >> 1;
             if (data[i++] & 0b00000001) {
                 rl = 1;
@@ -223,7 +392,7 @@ class byte_block {
         }
     }
 
-    inline void get(uint32_t& i, uint32_t& rl, uint8_t offset) const {
+    __attribute__((always_inline)) inline void get(uint32_t& i, uint32_t& rl, uint8_t offset) const {
         const uint8_t* data = reinterpret_cast<const uint8_t*>(this);
         if (block_size <= (uint32_t(1) << (8 + offset))) {
             rl |= data[i++] << offset;
@@ -0,0 +1,292 @@
+#pragma once
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace bbwt {
+
+// Sections of a single-file index. Ids are stable on disk.
+enum class section : uint32_t {
+    statics = 1,      // alphabet, super block and block statics
+    p_sums = 2,       // root partial sums, one per super block (+ totals)
+    directory = 3,    // byte offset of each super block in block_data (+ end)
+    block_data = 4,   // super blocks or run blocks
+    char_counts = 5,  // 257 cumulative symbol counts
+    heap = 6,         // b_heap over run block start positions
+    sa_samples = 7,   // suffix array samples at run ends, see locate.hpp
+    phi = 8,          // b_heap over suffix array samples at run starts
+    isa_samples = 9,  // inverse suffix array samples, see extract.hpp
+    kmers = 10,       // BWT ranges of all k-mers, see kmer_table.hpp
+    start_samples = 11,  // suffix array samples at run starts by row, see locate.hpp
+};
+
+enum class index_kind : uint32_t { block = 1, run = 2 };
+
+// Block encodings are given by block_type::encoding:
+//   1 two_byte_block, 2 byte_block, 3 one_byte_block, 4 vbyte_runs,
+//   (a << 8) | b for d_block<a, b>.
+
+// Regular sections are page aligned. Block data is aligned to 2 MiB so it can
+// be backed by huge pages when mapped or copied.
+static const constexpr uint64_t SECTION_ALIGN = uint64_t(1) << 12;
+static const constexpr uint64_t HUGE_ALIGN = uint64_t(1) << 21;
+
+inline uint32_t crc32c(uint32_t crc, const void* data, uint64_t n) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    uint32_t c = ~crc;
+#ifdef __SSE4_2__
+    uint64_t c64 = c;
+    while (n >= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(uint64_t));
+        c64 = _mm_crc32_u64(c64, v);
+        p += 8;
+        n -= 8;
+    }
+    c = c64;
+    while (n--) {
+        c = _mm_crc32_u8(c, *p++);
+    }
+#else
+    static const constexpr auto table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t v = i;
+            for (uint32_t k = 0; k < 8; k++) {
+                v = (v >> 1) ^ (v & 1 ? 0x82F63B78 : 0);
+            }
+            t[i] = v;
+        }
+        return t;
+    }();
+    while (n--) {
+        c = table[(c ^ *p++) & 0xff] ^ (c >> 8);
+    }
+#endif
+    return ~c;
+}
+
+struct section_entry {
+    uint32_t id;
+    uint32_t crc;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct container_header {
+    static const constexpr char MAGIC[8] = {'B', 'B', 'W', 'T', 'I', 'D', 'X', '\0'};
+    static const constexpr uint32_t VERSION = 1;
+    static const constexpr uint32_t MAX_SECTIONS = 32;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    uint64_t elems;
+    uint64_t blocks;
+    uint32_t section_count;
+    uint32_t encoding;
+    uint32_t block_size;
+    uint32_t reserved[5];
+    section_entry sections[MAX_SECTIONS];
+};
+
+static_assert(sizeof(container_header) <= SECTION_ALIGN);
+
+// Writes a container. Sections are written one at a time, in any order, and
+// the header with the section table is written last by finalize.
+class container_writer {
+   private:
+    std::fstream out_;
+    container_header header_;
+    section_entry* current_;
+    uint64_t offset_;
+
+   public:
+    container_writer(const std::string& path, index_kind kind,
+                     uint32_t encoding, uint32_t block_size)
+        : header_(), current_(nullptr), offset_(sizeof(container_header)) {
+        out_.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+        if (out_.fail()) {
+            std::cerr << "Opening " << path << " for writing failed!" << std::endl;
+            exit(1);
+        }
+        std::memcpy(header_.magic, container_header::MAGIC, 8);
+        header_.version = container_header::VERSION;
+        header_.kind = static_cast<uint32_t>(kind);
+        header_.encoding = encoding;
+        header_.block_size = block_size;
+    }
+
+    // Opens an existing container to add sections to it.
+    container_writer(const std::string& path)
+        : header_(), current_(nullptr), offset_(sizeof(container_header)) {
+        out_.open(path, std::ios::binary | std::ios::in | std::ios::out);
+        if (!out_.read(reinterpret_cast<char*>(&header_), sizeof(container_header)) ||
+            std::memcmp(header_.magic, container_header::MAGIC, 8) != 0) {
+            std::cerr << path << " is not an index container" << std::endl;
+            exit(1);
+        }
+        for (uint32_t i = 0; i < header_.section_count; i++) {
+            uint64_t end = header_.sections[i].offset + header_.sections[i].size;
+            offset_ = end > offset_ ? end : offset_;
+        }
+    }
+
+    void begin(section id, uint64_t alignment = SECTION_ALIGN) {
+        if (header_.section_count >= container_header::MAX_SECTIONS) {
+            std::cerr << "Too many sections in index container" << std::endl;
+            exit(1);
+        }
+        // Padding is skipped over, leaving holes in the file.
+        offset_ += (alignment - offset_ % alignment) % alignment;
+        out_.seekp(offset_);
+        current_ = header_.sections + header_.section_count++;
+        current_->id = static_cast<uint32_t>(id);
+        current_->crc = 0;
+        current_->offset = offset_;
+        current_->size = 0;
+    }
+
+    void write(const char* data, std::streamsize n) {
+        out_.write(data, n);
+        current_->crc = crc32c(current_->crc, data, n);
+        current_->size += n;
+        offset_ += n;
+    }
+
+    void end() { current_ = nullptr; }
+
+    uint64_t section_bytes() const { return current_->size; }
+
+    void finalize(uint64_t elems, uint64_t blocks) {
+        header_.elems = elems;
+        header_.blocks = blocks;
+        finalize();
+    }
+
+    void finalize() {
+        out_.seekp(0);
+        out_.write(reinterpret_cast<char*>(&header_), sizeof(container_header));
+        out_.close();
+    }
+};
+
+// Header and section table of a container on disk. Checksums are not checked
+// on load, use verify() for that.
+class container {
+   private:
+    std::string path_;
+    container_header header_;
+
+   public:
+    static bool is_container(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        char magic[8];
+        if (!in.read(magic, 8)) {
+            return false;
+        }
+        return std::memcmp(magic, container_header::MAGIC, 8) == 0;
+    }
+
+    container(const std::string& path, index_kind kind) : container(path) {
+        if (header_.kind != static_cast<uint32_t>(kind)) {
+            std::cerr << path << " contains a different kind of index" << std::endl;
+            exit(1);
+        }
+    }
+
+    // As above, and the blocks have to be of the given encoding and size, as
+    // the typed index reading them would otherwise give wrong results.
+    container(const std::string& path, index_kind kind, uint32_t encoding, uint32_t block_size)
+        : container(path, kind) {
+        if (header_.encoding != encoding || header_.block_size != block_size) {
+            std::cerr << path << " has blocks of encoding " << header_.encoding << " and size "
+                      << header_.block_size << ", expected encoding " << encoding
+                      << " and size " << block_size << std::endl;
+            exit(1);
+        }
+    }
+
+    container(const std::string& path) : path_(path), header_() {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.read(reinterpret_cast<char*>(&header_), sizeof(container_header))) {
+            std::cerr << "Reading index header from " << path << " failed!" << std::endl;
+            exit(1);
+        }
+        if (std::memcmp(header_.magic, container_header::MAGIC, 8) != 0) {
+            std::cerr << path << " is not an index container" << std::endl;
+            exit(1);
+        }
+        if (header_.version != container_header::VERSION) {
+            std::cerr << path << " has unsupported index version "
+                      << header_.version << std::endl;
+            exit(1);
+        }
+    }
+
+    index_kind kind() const { return static_cast<index_kind>(header_.kind); }
+    uint32_t encoding() const { return header_.encoding; }
+    uint32_t block_size() const { return header_.block_size; }
+    uint64_t elems() const { return header_.elems; }
+    uint64_t blocks() const { return header_.blocks; }
+
+    const section_entry* find(section id) const {
+        for (uint32_t i = 0; i < header_.section_count; i++) {
+            if (header_.sections[i].id == static_cast<uint32_t>(id)) {
+                return header_.sections + i;
+            }
+        }
+        return nullptr;
+    }
+
+    const section_entry& get(section id) const {
+        const section_entry* e = find(id);
+        if (e == nullptr) {
+            std::cerr << path_ << " is missing section "
+                      << static_cast<uint32_t>(id) << std::endl;
+            exit(1);
+        }
+        return *e;
+    }
+
+    void seek(std::fstream& in, section id) const {
+        in.seekg(get(id).offset);
+    }
+
+    bool verify(section id) const {
+        const section_entry& e = get(id);
+        std::ifstream in(path_, std::ios::binary);
+        in.seekg(e.offset);
+        std::vector<char> buf(uint64_t(1) << 20);
+        uint32_t crc = 0;
+        uint64_t left = e.size;
+        while (left) {
+            uint64_t n = left < buf.size() ? left : buf.size();
+            if (!in.read(buf.data(), n)) {
+                return false;
+            }
+            crc = crc32c(crc, buf.data(), n);
+            left -= n;
+        }
+        return crc == e.crc;
+    }
+
+    bool verify() const {
+        for (uint32_t i = 0; i < header_.section_count; i++) {
+            if (!verify(static_cast<section>(header_.sections[i].id))) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+}  // namespace bbwt
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <cmath>
+#include <optional>
+#include <utility>
 
 #include "debug.hpp"
 
@@ -14,8 +17,11 @@ class d_block {
     static_assert(block_a::cap == block_b::cap);
    public:
     typedef typename block_a::alphabet_type alphabet_type;
+    typedef typename alphabet_type::meta_type meta_type;
     static const constexpr bool has_members = true;
     static const constexpr uint32_t cap = block_a::cap;
+    static const constexpr uint32_t encoding =
+        (block_a::encoding << 8) | block_b::encoding;
     static const constexpr uint32_t scratch_blocks =
         1 + block_a::scratch_blocks + block_b::scratch_blocks;
     static const constexpr uint32_t min_size =
@@ -50,13 +56,14 @@ class d_block {
     d_block& operator=(d_block&& other) = delete;
     d_block& operator=(const d_block&) = delete;
 
-    uint32_t append(uint8_t head, uint32_t length, uint8_t** scratch) {
+    uint32_t append(uint8_t head, uint32_t length, uint8_t** scratch,
+                    const meta_type& m) {
         scratch[0][sizeof(block_a) + sizeof(block_b)] += 1;
         uint32_t a_size = reinterpret_cast<block_a*>(scratch[0])
-                              ->append(head, length, scratch + 1);
+                              ->append(head, length, scratch + 1, m);
         uint32_t b_size =
             reinterpret_cast<block_b*>(scratch[0] + sizeof(block_a))
-                ->append(head, length, scratch + 1 + block_a::scratch_blocks);
+                ->append(head, length, scratch + 1 + block_a::scratch_blocks, m);
         if (scratch[0][sizeof(block_a) + sizeof(block_b)] >= std::log2(block_a::cap)) {
             b_type = 1;
             return b_size;
@@ -73,19 +80,78 @@ class d_block {
         }*/
     }
 
-    uint8_t at(uint32_t location) const {
+    uint8_t at(uint32_t location, const meta_type& m) const {
         if (b_type) {
-            return reinterpret_cast<const block_b*>(&b_type + 1)->at(location);
+            return reinterpret_cast<const block_b*>(&b_type + 1)->at(location, m);
         } else {
-            return reinterpret_cast<const block_a*>(&b_type + 1)->at(location);
+            return reinterpret_cast<const block_a*>(&b_type + 1)->at(location, m);
         }
     }
 
-    uint32_t rank(uint8_t c, uint32_t location) const {
+    uint32_t rank(uint8_t c, uint32_t location, const meta_type& m) const {
         if (b_type) {
-            return reinterpret_cast<const block_b*>(&b_type + 1)->rank(c, location);
+            return reinterpret_cast<const block_b*>(&b_type + 1)->rank(c, location, m);
         } else {
-            return reinterpret_cast<const block_a*>(&b_type + 1)->rank(c, location);
+            return reinterpret_cast<const block_a*>(&b_type + 1)->rank(c, location, m);
+        }
+    }
+
+    uint32_t rank_less(const uint32_t* less, uint32_t location, const meta_type& m) const {
+        if (b_type) {
+            return reinterpret_cast<const block_b*>(&b_type + 1)->rank_less(less, location, m);
+        } else {
+            return reinterpret_cast<const block_a*>(&b_type + 1)->rank_less(less, location, m);
+        }
+    }
+
+    std::pair<uint8_t, uint32_t> inverse_select(uint32_t location, const meta_type& m) const {
+        if (b_type) {
+            return reinterpret_cast<const block_b*>(&b_type + 1)->inverse_select(location, m);
+        } else {
+            return reinterpret_cast<const block_a*>(&b_type + 1)->inverse_select(location, m);
+        }
+    }
+
+    void rank_all(uint32_t location, uint64_t* out, const meta_type& m) const {
+        if (b_type) {
+            reinterpret_cast<const block_b*>(&b_type + 1)->rank_all(location, out, m);
+        } else {
+            reinterpret_cast<const block_a*>(&b_type + 1)->rank_all(location, out, m);
+        }
+    }
+
+    void rank_all_pair(uint32_t a, uint32_t b, uint64_t* ra, uint64_t* rb,
+                       const meta_type& m) const {
+        if (b_type) {
+            reinterpret_cast<const block_b*>(&b_type + 1)->rank_all_pair(a, b, ra, rb, m);
+        } else {
+            reinterpret_cast<const block_a*>(&b_type + 1)->rank_all_pair(a, b, ra, rb, m);
+        }
+    }
+
+    std::optional<std::pair<uint32_t, uint32_t>> run_rank(uint8_t c, uint32_t a, uint32_t b,
+                                                          const meta_type& m) const {
+        if (b_type) {
+            return reinterpret_cast<const block_b*>(&b_type + 1)->run_rank(c, a, b, m);
+        } else {
+            return reinterpret_cast<const block_a*>(&b_type + 1)->run_rank(c, a, b, m);
+        }
+    }
+
+    std::pair<uint32_t, uint32_t> rank_pair(uint8_t c, uint32_t a, uint32_t b,
+                                            const meta_type& m) const {
+        if (b_type) {
+            return reinterpret_cast<const block_b*>(&b_type + 1)->rank_pair(c, a, b, m);
+        } else {
+            return reinterpret_cast<const block_a*>(&b_type + 1)->rank_pair(c, a, b, m);
+        }
+    }
+
+    uint32_t select(uint8_t c, uint32_t k, const meta_type& m) const {
+        if (b_type) {
+            return reinterpret_cast<const block_b*>(&b_type + 1)->select(c, k, m);
+        } else {
+            return reinterpret_cast<const block_a*>(&b_type + 1)->select(c, k, m);
         }
     }
 
@@ -110,20 +176,22 @@ class d_block {
         return bytes;
     }
 
-    void print(uint32_t sb) {
+    void print(uint32_t sb, const meta_type& m) const {
         if (b_type) {
-            reinterpret_cast<const block_b*>(&b_type + 1)->print(sb);
+            reinterpret_cast<const block_b*>(&b_type + 1)->print(sb, m);
         } else {
-            reinterpret_cast<const block_a*>(&b_type + 1)->print(sb);
+            reinterpret_cast<const block_a*>(&b_type + 1)->print(sb, m);
         }
     }
 
     void clear() {}
-    static void write_statics(std::fstream& out) {
+    template <class o_t>
+    static void write_statics(o_t& out) {
         block_a::write_statics(out);
         block_b::write_statics(out);
     }
-    static uint64_t load_statics(std::fstream& in) {
+    template <class i_t>
+    static uint64_t load_statics(i_t& in) {
         return block_a::load_statics(in) + block_b::load_statics(in);
     }
 };
@@ -4,6 +4,8 @@
 #include <cstring>
 #include <cstdint>
 
+#include "alphabet_meta.hpp"
+
 namespace bbwt {
 template <class dtype, uint8_t smallest, uint8_t largest>
 class delta_alphabet {
@@ -12,6 +14,7 @@ class delta_alphabet {
     dtype counts_[A_SIZE];
 
   public:
+    typedef static_meta<delta_alphabet> meta_type;
     static const constexpr uint8_t width = 8 * sizeof(unsigned int) - __builtin_clz(largest - smallest) ;
     static constexpr uint8_t convert(uint8_t c) {
         return c - smallest;
@@ -43,16 +46,18 @@ class delta_alphabet {
         std::memset(counts_, 0, sizeof(dtype) * A_SIZE);
     }
 
-    dtype p_sum(uint8_t c) const {
+    dtype p_sum(uint8_t c, const meta_type& = meta_type()) const {
         return counts_[c];
     }
 
-    void print() {
+    void print(const meta_type& = meta_type()) {
         for (uint16_t i = 0; i < A_SIZE; i++) {
             std::cerr << i << ": " << counts_[i] << std::endl;
         }
     }
-    static void write_statics(std::fstream&) {return; }
-    static uint64_t load_statics(std::fstream&) {return 0; }
+    template <class o_t>
+    static void write_statics(o_t&) {return; }
+    template <class i_t>
+    static uint64_t load_statics(i_t&) {return 0; }
 };
 } // namespace bbwt
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "container.hpp"
+#include "locate.hpp"
+
+#ifndef EXTRACT_WINDOW
+#define EXTRACT_WINDOW 16
+#endif
+
+namespace bbwt {
+
+// Random access to the text of an index.
+//
+// The inverse suffix array is sampled at every step:th text position, so the
+// row of text position j is known for j % step == 0. A substring is extracted
+// by walking LF backwards from the first sample at or after its end, which
+// takes at most step - 1 extra LF steps per substring.
+//
+// Samples are stored as an extra section in the index container, and are made
+// with build from a finished index.
+template <class bwt_type>
+class extractor {
+   private:
+    const bwt_type* bwt_;
+    uint64_t size_;
+    uint64_t step_;
+    std::vector<uint64_t> rows_;
+    uint64_t bytes_;
+
+    // State of a walk in extract_many. The walk is at text position t and
+    // fills snippet k, which is the text in [pos, end).
+    struct walk {
+        size_t k;
+        uint64_t pos;
+        uint64_t end;
+        uint64_t t;
+    };
+
+   public:
+    extractor(const bwt_type& bwt, const std::string& path)
+        : bwt_(&bwt), size_(0), step_(0), rows_(), bytes_(0) {
+        container c(path);
+        if (c.find(section::isa_samples) == nullptr) {
+            std::cerr << path << " has no extract support, see make_bwt -x" << std::endl;
+            exit(1);
+        }
+        std::fstream in_file;
+        in_file.open(path, std::ios::binary | std::ios::in);
+        c.seek(in_file, section::isa_samples);
+        uint64_t samples;
+        in_file.read(reinterpret_cast<char*>(&size_), sizeof(uint64_t));
+        in_file.read(reinterpret_cast<char*>(&step_), sizeof(uint64_t));
+        in_file.read(reinterpret_cast<char*>(&samples), sizeof(uint64_t));
+        rows_.resize(samples);
+        in_file.read(reinterpret_cast<char*>(rows_.data()), sizeof(uint64_t) * samples);
+        bytes_ = sizeof(extractor) + sizeof(uint64_t) * samples;
+        if (size_ != bwt.size()) {
+            std::cerr << "Extract samples in " << path << " do not match the index" << std::endl;
+            exit(1);
+        }
+    }
+
+    // Text from position pos, up to len symbols.
+    std::string extract(uint64_t pos, uint64_t len) const {
+        walk w;
+        uint64_t row = start(pos, len, 0, w);
+        std::string res(w.end - w.pos, '\0');
+        for (; w.t > w.pos; w.t--) {
+            auto r = bwt_->inverse_select(row);
+            if (w.t <= w.end) {
+                res[w.t - 1 - w.pos] = r.first;
+            }
+            row = bwt_->C(r.first) + r.second;
+        }
+        return res;
+    }
+
+    // out[k] = extract(pos[k], len[k]) for k < n.
+    //
+    // Up to EXTRACT_WINDOW walks are kept in flight, and each round takes one
+    // LF step of every active walk with LF_batch, so the cache misses of the
+    // walks overlap. Finished walks are replaced by the next snippet.
+    void extract_many(const uint64_t* pos, const uint64_t* len, std::string* out, size_t n) const {
+        walk w[EXTRACT_WINDOW];
+        uint64_t rows[EXTRACT_WINDOW];
+        uint8_t syms[EXTRACT_WINDOW];
+        size_t active = 0;
+        size_t next = 0;
+        while (true) {
+            while (active < EXTRACT_WINDOW && next < n) {
+                rows[active] = start(pos[next], len[next], next, w[active]);
+                out[next].assign(w[active].end - w[active].pos, '\0');
+                if (w[active].t > w[active].pos) {
+                    active++;
+                }
+                next++;
+            }
+            if (active == 0) {
+                break;
+            }
+            bwt_->LF_batch(rows, syms, active);
+            for (size_t k = 0; k < active;) {
+                walk& s = w[k];
+                if (s.t <= s.end) {
+                    out[s.k][s.t - 1 - s.pos] = syms[k];
+                }
+                if (--s.t == s.pos) {
+                    active--;
+                    s = w[active];
+                    rows[k] = rows[active];
+                    syms[k] = syms[active];
+                } else {
+                    k++;
+                }
+            }
+        }
+    }
+
+    uint64_t step() const { return step_; }
+    uint64_t bytes() const { return bytes_; }
+
+    // Samples the inverse suffix array of the index in path every step text
+    // positions by walking LF over the whole BWT, and adds the samples to the
+    // container. terminator is the last symbol of the text and has to occur
+    // exactly once.
+    static void build(const bwt_type& bwt, uint8_t terminator, uint64_t step,
+                      const std::string& path) {
+        uint64_t n = bwt.size();
+        uint64_t samples = (n + step - 1) / step;
+        std::vector<uint64_t> rows(samples);
+        uint64_t k = terminator_row(bwt, terminator);
+        rows[0] = k;
+        for (uint64_t t = n - 1; t > 0; t--) {
+            k = bwt.LF(k);
+            if (t % step == 0) {
+                rows[t / step] = k;
+            }
+        }
+        container_writer out(path);
+        out.begin(section::isa_samples);
+        out.write(reinterpret_cast<char*>(&n), sizeof(uint64_t));
+        out.write(reinterpret_cast<char*>(&step), sizeof(uint64_t));
+        out.write(reinterpret_cast<char*>(&samples), sizeof(uint64_t));
+        out.write(reinterpret_cast<char*>(rows.data()), sizeof(uint64_t) * samples);
+        out.end();
+        out.finalize();
+        std::cerr << "Sampled inverse suffix array at " << samples << " positions for extract" << std::endl;
+    }
+
+   private:
+    // Sets up the walk for extract(pos, len) and returns its first row. The
+    // walk starts at the first sample at or after the end of the snippet.
+    uint64_t start(uint64_t pos, uint64_t len, size_t k, walk& w) const {
+        pos = pos < size_ ? pos : size_;
+        uint64_t end = len < size_ - pos ? pos + len : size_;
+        uint64_t j = (end + step_ - 1) / step_;
+        w = {k, pos, end, pos};
+        if (end == pos) {
+            return 0;
+        }
+        if (j * step_ >= size_) {
+            // The row of text position 0 holds the last symbol of the text.
+            w.t = size_;
+            return rows_[0];
+        }
+        w.t = j * step_;
+        return rows_[j];
+    }
+};
+}  // namespace bbwt
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+
+#include "mapped_file.hpp"
+
+namespace bbwt {
+
+// Rows of a pattern P and of its reverse complement in an FMD-index. P is in
+// rows [k, k + s) and the reverse complement of P in rows [l, l + s).
+struct bi_interval {
+    uint64_t k;
+    uint64_t l;
+    uint64_t s;
+};
+
+// FMD-index of Li (Exploring single-sample SNP and INDEL calling with
+// whole-genome de novo assembly, 2012) on top of a block index.
+//
+// The BWT has to be of a DNA text together with its reverse complement, e.g.
+// T#R$ where R is the reverse complement of T. Then the reverse complement of
+// every pattern occurs as often as the pattern, and the rows of the reverse
+// complement can be kept up to date during backward search. Extending a
+// pattern forward with c is a backward extension of its reverse complement
+// with the complement of c, so patterns can be extended in both directions.
+//
+// A, C, G and T (and lower case a, c, g and t) are complemented, all other
+// symbols such as N or separators are their own complement.
+template <class bwt_type>
+class fmd_index {
+   private:
+    bwt_type bwt_;
+    uint8_t comp_[256];
+    // Indexes of rank_all results in increasing order of complement symbol.
+    uint16_t order_[256];
+
+   public:
+    fmd_index(std::string path, load_mode mode = load_mode::stream) : bwt_(path, mode) {
+        for (uint16_t c = 0; c < 256; c++) {
+            comp_[c] = c;
+        }
+        const char* pairs[] = {"AT", "CG", "at", "cg"};
+        for (const char* p : pairs) {
+            comp_[uint8_t(p[0])] = p[1];
+            comp_[uint8_t(p[1])] = p[0];
+        }
+        uint16_t sigma = bwt_.sigma();
+        for (uint16_t k = 0; k < sigma; k++) {
+            uint8_t c = bwt_.symbol(k);
+            if (count(c) != count(comp_[c])) {
+                std::cerr << path << " is not a BWT of a text with its reverse complement, "
+                          << c << " occurs " << count(c) << " times and " << comp_[c] << " "
+                          << count(comp_[c]) << " times" << std::endl;
+                exit(1);
+            }
+            order_[k] = k;
+        }
+        std::sort(order_, order_ + sigma, [&](uint16_t a, uint16_t b) {
+            return comp_[bwt_.symbol(a)] < comp_[bwt_.symbol(b)];
+        });
+    }
+
+    // Interval of the empty pattern.
+    bi_interval all() const { return {0, 0, bwt_.size()}; }
+
+    // Interval of the pattern c.
+    bi_interval init(uint8_t c) const { return {bwt_.C(c), bwt_.C(comp_[c]), count(c)}; }
+
+    // Interval of cP from the interval x of P.
+    //
+    // cP is in rows k + [rank(k, c), rank(k + s, c)). Rows of the reverse
+    // complement of P are ordered by the symbol after it, so the reverse
+    // complement of cP follows those of P followed by a symbol smaller than
+    // the complement of c. Both ends come from a rank_all each.
+    bi_interval backward(const bi_interval& x, uint8_t c) const {
+        if (x.s == 0) [[unlikely]] {
+            return x;
+        }
+        uint64_t ra[256];
+        uint64_t rb[256];
+        bwt_.rank_all(x.k, ra);
+        bwt_.rank_all(x.k + x.s, rb);
+        uint64_t l = x.l;
+        for (uint16_t j = 0; j < bwt_.sigma(); j++) {
+            uint16_t q = order_[j];
+            if (bwt_.symbol(q) == c) {
+                return {bwt_.C(c) + ra[q], l, rb[q] - ra[q]};
+            }
+            l += rb[q] - ra[q];
+        }
+        return {0, 0, 0};
+    }
+
+    // Interval of Pc from the interval x of P.
+    bi_interval forward(const bi_interval& x, uint8_t c) const {
+        bi_interval r = backward({x.l, x.k, x.s}, comp_[c]);
+        return {r.l, r.k, r.s};
+    }
+
+    // Interval of pattern by backward search.
+    bi_interval find(const std::string& pattern) const {
+        bi_interval x = all();
+        for (size_t i = pattern.size() - 1; i < pattern.size() && x.s > 0; i--) {
+            x = backward(x, pattern[i]);
+        }
+        return x;
+    }
+
+    uint8_t complement(uint8_t c) const { return comp_[c]; }
+    const bwt_type& bwt() const { return bwt_; }
+    uint64_t size() const { return bwt_.size(); }
+    uint64_t bytes() const { return bwt_.bytes() - sizeof(bwt_type) + sizeof(fmd_index); }
+
+   private:
+    uint64_t count(uint8_t c) const {
+        return (c == 255 ? bwt_.size() : bwt_.C(c + 1)) - bwt_.C(c);
+    }
+};
+}  // namespace bbwt
@@ -4,6 +4,8 @@
 #include <cstdint>
 #include <cstdint>
 
+#include "alphabet_meta.hpp"
+
 namespace bbwt {
 template <class dtype>
 class genomics_alphabet {
@@ -13,6 +15,7 @@ class genomics_alphabet {
     static const constexpr uint8_t MASK = 0b00011111;
 
    public:
+    typedef static_meta<genomics_alphabet> meta_type;
     static const constexpr uint8_t width = 5;
     static constexpr uint8_t convert(uint8_t c) {
         uint8_t v = (~c >> 6) & (c >> 5) & ONE;
@@ -57,14 +60,16 @@ class genomics_alphabet {
 
     void clear() { std::memset(this, 0, sizeof(genomics_alphabet)); }
 
-    dtype p_sum(uint8_t c) const { return counts_[c]; }
+    dtype p_sum(uint8_t c, const meta_type& = meta_type()) const { return counts_[c]; }
 
-    void print() const {
+    void print(const meta_type& = meta_type()) const {
         for (uint32_t i = 0; i < 32; i++) {
             std::cerr << int(revert(i)) << ": " << counts_[i] << std::endl;
         }
     }
-    static uint64_t write_statics(std::fstream&) {return 0; }
-    static uint64_t load_statics(std::fstream&) {return 0; }
+    template <class o_t>
+    static uint64_t write_statics(o_t&) {return 0; }
+    template <class i_t>
+    static uint64_t load_statics(i_t&) {return 0; }
 };
 }  // namespace bbwt
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef CACHE_LINE
+#define CACHE_LINE 64
+#endif
+
+#ifndef CACHE_SHARDS
+#define CACHE_SHARDS 64
+#endif
+
+#ifndef CACHE_ENTRIES
+#define CACHE_ENTRIES (uint64_t(1) << 16)
+#endif
+
+namespace bbwt {
+
+// Bounded cache of the BWT ranges of pattern suffixes, for query workloads
+// where the same suffixes come back often.
+//
+// Only whole patterns and suffixes of power of two lengths are cached, so a
+// lookup probes O(log m) suffixes of a pattern of length m, longest first.
+// Entries are spread over CACHE_SHARDS shards by the hash of the suffix, each
+// with its own lock, so threads querying through the same cache rarely wait on
+// each other. Within a shard the cache is direct mapped, and a new entry
+// replaces whatever was in its slot.
+//
+// A cache holds ranges of one index, see set_cache of the indexes.
+class interval_cache {
+   private:
+    struct slot {
+        uint64_t hash;
+        uint64_t a;
+        uint64_t b;
+        std::string key;
+    };
+
+    struct alignas(CACHE_LINE) shard {
+        std::mutex mutex;
+        std::vector<slot> slots;
+        std::atomic<uint64_t> lookups;
+        std::atomic<uint64_t> hits;
+        std::atomic<uint64_t> saved;
+    };
+
+    std::unique_ptr<shard[]> shards_;
+    uint64_t mask_;
+
+   public:
+    // Cache of about entries suffix ranges.
+    interval_cache(uint64_t entries = CACHE_ENTRIES) : shards_(new shard[CACHE_SHARDS]), mask_(0) {
+        uint64_t per_shard = 1;
+        while (per_shard * CACHE_SHARDS < entries) {
+            per_shard *= 2;
+        }
+        mask_ = per_shard - 1;
+        for (uint32_t i = 0; i < CACHE_SHARDS; i++) {
+            shards_[i].slots.assign(per_shard, {0, 0, 0, std::string()});
+            shards_[i].lookups.store(0, std::memory_order_relaxed);
+            shards_[i].hits.store(0, std::memory_order_relaxed);
+            shards_[i].saved.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    interval_cache(const interval_cache&) = delete;
+    interval_cache& operator=(const interval_cache&) = delete;
+
+    // Whether the suffix of length len of a longer pattern is cached.
+    static bool keeps(uint64_t len) { return len >= 2 && (len & (len - 1)) == 0; }
+
+    // Length of the longest cached suffix of pattern, with its range in
+    // [a, b), or 0 if no suffix is cached.
+    uint64_t find(const std::string& pattern, uint64_t& a, uint64_t& b) {
+        uint64_t m = pattern.size();
+        uint64_t lens[66];
+        uint64_t hashes[66];
+        uint32_t n = 0;
+        uint64_t h = 0;
+        for (uint64_t len = 1; len <= m; len++) {
+            h = extend(h, pattern[m - len]);
+            if (len == m || keeps(len)) {
+                lens[n] = len;
+                hashes[n++] = mix(h);
+            }
+        }
+        for (uint32_t j = n - 1; j < n; j--) {
+            shard& s = shards_[hashes[j] % CACHE_SHARDS];
+            std::lock_guard<std::mutex> lock(s.mutex);
+            const slot& e = s.slots[(hashes[j] / CACHE_SHARDS) & mask_];
+            if (e.hash == hashes[j] && e.key.size() == lens[j] &&
+                std::memcmp(e.key.data(), pattern.data() + m - lens[j], lens[j]) == 0) {
+                a = e.a;
+                b = e.b;
+                s.lookups.fetch_add(1, std::memory_order_relaxed);
+                s.hits.fetch_add(1, std::memory_order_relaxed);
+                s.saved.fetch_add(lens[j], std::memory_order_relaxed);
+                return lens[j];
+            }
+        }
+        if (n) {
+            shards_[hashes[n - 1] % CACHE_SHARDS].lookups.fetch_add(1, std::memory_order_relaxed);
+        }
+        return 0;
+    }
+
+    // Stores [a, b) as the range of the len symbols from s.
+    void insert(const char* s, uint64_t len, uint64_t a, uint64_t b) {
+        uint64_t h = 0;
+        for (uint64_t i = len - 1; i < len; i--) {
+            h = extend(h, s[i]);
+        }
+        h = mix(h);
+        shard& sh = shards_[h % CACHE_SHARDS];
+        std::lock_guard<std::mutex> lock(sh.mutex);
+        slot& e = sh.slots[(h / CACHE_SHARDS) & mask_];
+        e.hash = h;
+        e.a = a;
+        e.b = b;
+        e.key.assign(s, len);
+    }
+
+    // Number of find calls, the ones that found a suffix, and the number of
+    // pattern symbols covered by the found suffixes.
+    uint64_t lookups() const { return sum(&shard::lookups); }
+    uint64_t hits() const { return sum(&shard::hits); }
+    uint64_t saved() const { return sum(&shard::saved); }
+
+    double hit_ratio() const {
+        uint64_t l = lookups();
+        return l ? double(hits()) / l : 0;
+    }
+
+   private:
+    static uint64_t extend(uint64_t h, char c) { return (h ^ uint8_t(c)) * 0x100000001B3; }
+
+    static uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCD;
+        h ^= h >> 33;
+        return h;
+    }
+
+    uint64_t sum(std::atomic<uint64_t> shard::*counter) const {
+        uint64_t res = 0;
+        for (uint32_t i = 0; i < CACHE_SHARDS; i++) {
+            res += (shards_[i].*counter).load(std::memory_order_relaxed);
+        }
+        return res;
+    }
+};
+}  // namespace bbwt
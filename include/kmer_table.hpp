@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "container.hpp"
+
+#ifndef KMER_DIRECT_ENTRIES
+#define KMER_DIRECT_ENTRIES (uint64_t(1) << 20)
+#endif
+
+namespace bbwt {
+
+// BWT ranges of all k-mers of a text, so that backward searches can start at
+// step k instead of taking the first k steps, which touch effectively random
+// blocks.
+//
+// k-mers are keyed by the index of each symbol in rank_all order, as a number
+// in base sigma with the first symbol most significant. If sigma^k is at most
+// KMER_DIRECT_ENTRIES the table is an array over all keys, otherwise it is an
+// open addressing hash of the k-mers that occur in the text.
+class kmer_table {
+   private:
+    struct entry {
+        uint64_t key;
+        uint64_t a;
+        uint64_t b;
+    };
+
+    uint16_t k_;
+    uint16_t sigma_;
+    bool direct_;
+    uint16_t code_[256];
+    std::vector<entry> entries_;
+    uint64_t mask_;
+
+   public:
+    kmer_table() : k_(0), sigma_(0), direct_(true), code_(), entries_(), mask_(0) {}
+
+    // Makes the table for the given index by backward searching all k-mers
+    // that occur, branching with rank_all.
+    template <class bwt_type>
+    static kmer_table build(const bwt_type& bwt, uint16_t k) {
+        kmer_table t;
+        t.k_ = k;
+        t.sigma_ = bwt.sigma();
+        std::fill_n(t.code_, 256, t.sigma_);
+        for (uint16_t s = 0; s < t.sigma_; s++) {
+            t.code_[bwt.symbol(s)] = s;
+        }
+        uint64_t keys = 1;
+        for (uint16_t i = 0; i < k; i++) {
+            if (keys > ~uint64_t(0) / t.sigma_) {
+                std::cerr << k << "-mers over " << t.sigma_ << " symbols do not fit in 64-bit keys" << std::endl;
+                exit(1);
+            }
+            keys *= t.sigma_;
+        }
+        std::vector<entry> found;
+        std::vector<uint64_t> ra(t.sigma_);
+        std::vector<uint64_t> rb(t.sigma_);
+        // Extending a k-mer to the left adds its most significant digit.
+        std::vector<std::pair<entry, uint16_t>> stack = {{{0, 0, bwt.size()}, 0}};
+        std::vector<uint64_t> places(k + 1, 1);
+        for (uint16_t i = 1; i <= k; i++) {
+            places[i] = places[i - 1] * t.sigma_;
+        }
+        while (stack.size()) {
+            auto [e, depth] = stack.back();
+            stack.pop_back();
+            if (depth == k) {
+                found.push_back(e);
+                continue;
+            }
+            bwt.rank_all(e.a, ra.data());
+            bwt.rank_all(e.b, rb.data());
+            for (uint16_t s = 0; s < t.sigma_; s++) {
+                if (ra[s] == rb[s]) {
+                    continue;
+                }
+                uint64_t c = bwt.C(bwt.symbol(s));
+                stack.push_back({{e.key + s * places[depth], c + ra[s], c + rb[s]}, uint16_t(depth + 1)});
+            }
+        }
+        if (keys <= KMER_DIRECT_ENTRIES) {
+            t.direct_ = true;
+            t.entries_.assign(keys, {0, 0, 0});
+            for (const auto& e : found) {
+                t.entries_[e.key] = e;
+            }
+        } else {
+            t.direct_ = false;
+            uint64_t cap = 1;
+            while (cap < 2 * found.size()) {
+                cap *= 2;
+            }
+            t.mask_ = cap - 1;
+            t.entries_.assign(cap, {~uint64_t(0), 0, 0});
+            for (const auto& e : found) {
+                uint64_t h = t.hash(e.key);
+                while (t.entries_[h].key != ~uint64_t(0)) {
+                    h = (h + 1) & t.mask_;
+                }
+                t.entries_[h] = e;
+            }
+        }
+        return t;
+    }
+
+    // Range of the k symbols from s, which is empty if they do not occur.
+    std::pair<uint64_t, uint64_t> find(const char* s) const {
+        uint64_t key = 0;
+        for (uint16_t i = 0; i < k_; i++) {
+            uint16_t c = code_[uint8_t(s[i])];
+            if (c == sigma_) [[unlikely]] {
+                return {0, 0};
+            }
+            key = key * sigma_ + c;
+        }
+        if (direct_) {
+            const entry& e = entries_[key];
+            return {e.a, e.b};
+        }
+        for (uint64_t h = hash(key);; h = (h + 1) & mask_) {
+            const entry& e = entries_[h];
+            if (e.key == key) {
+                return {e.a, e.b};
+            } else if (e.key == ~uint64_t(0)) {
+                return {0, 0};
+            }
+        }
+    }
+
+    // Whether patterns of length m can start from the table.
+    bool covers(uint64_t m) const { return k_ && m >= k_; }
+    uint16_t k() const { return k_; }
+    bool direct() const { return direct_; }
+    uint64_t bytes() const { return sizeof(entry) * entries_.size(); }
+
+    void save(const std::string& path) const {
+        container_writer out(path);
+        out.begin(section::kmers);
+        uint64_t head[4] = {k_, sigma_, direct_, entries_.size()};
+        out.write(reinterpret_cast<const char*>(head), sizeof(head));
+        out.write(reinterpret_cast<const char*>(code_), sizeof(code_));
+        out.write(reinterpret_cast<const char*>(entries_.data()), sizeof(entry) * entries_.size());
+        out.end();
+        out.finalize();
+    }
+
+    // Loads the table of the index in path, if it has one.
+    void load(const std::string& path) {
+        container c(path);
+        if (c.find(section::kmers) == nullptr) {
+            return;
+        }
+        std::fstream in_file;
+        in_file.open(path, std::ios::binary | std::ios::in);
+        c.seek(in_file, section::kmers);
+        uint64_t head[4];
+        in_file.read(reinterpret_cast<char*>(head), sizeof(head));
+        in_file.read(reinterpret_cast<char*>(code_), sizeof(code_));
+        k_ = head[0];
+        sigma_ = head[1];
+        direct_ = head[2];
+        entries_.resize(head[3]);
+        in_file.read(reinterpret_cast<char*>(entries_.data()), sizeof(entry) * head[3]);
+        mask_ = head[3] - 1;
+    }
+
+   private:
+    uint64_t hash(uint64_t key) const {
+        uint64_t h = key * 0x9E3779B97F4A7C15;
+        return (h ^ (h >> 32)) & mask_;
+    }
+};
+}  // namespace bbwt
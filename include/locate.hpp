@@ -0,0 +1,279 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "b_heap.hpp"
+#include "container.hpp"
+
+namespace bbwt {
+
+// BWT positions where runs start, as seen by an index builder.
+class run_starts {
+   private:
+    std::vector<bool> starts_;
+    uint16_t last_;
+
+   public:
+    run_starts() : starts_(), last_(256) {}
+
+    void add(uint8_t head, uint64_t length) {
+        starts_.push_back(head != last_);
+        starts_.resize(starts_.size() + length - 1, false);
+        last_ = head;
+    }
+
+    bool operator[](uint64_t i) const { return starts_[i]; }
+    uint64_t size() const { return starts_.size(); }
+};
+
+// Row of the BWT that holds the last symbol of the text, that is, the row of
+// suffix array value 0. terminator has to occur exactly once.
+template <class bwt_type>
+uint64_t terminator_row(const bwt_type& bwt, uint8_t terminator) {
+    uint64_t n = bwt.size();
+    if (bwt.rank(n, terminator) != 1) {
+        std::cerr << "Text terminator " << terminator << " has to occur once" << std::endl;
+        exit(1);
+    }
+    uint64_t k = 0;
+    uint64_t hi = n - 1;
+    while (k < hi) {
+        uint64_t mid = (k + hi) / 2;
+        if (bwt.rank(mid + 1, terminator)) {
+            hi = mid;
+        } else {
+            k = mid + 1;
+        }
+    }
+    return k;
+}
+
+// Locate support following the r-index of Gagie, Navarro and Prezza.
+//
+// Suffix array values are sampled at the starts and ends of BWT runs, so the
+// samples take O(r) space. Backward search keeps SA of the last position of
+// the range up to date using the run end samples. The other occurrences are
+// found with phi(SA[k]) = SA[k - 1], from the closest run start sample that
+// precedes SA[k] in the text.
+//
+// Samples are stored as extra sections in the index container, and are made
+// with build from a finished index and the run starts seen by its builder.
+// The run start samples are also stored by row, for the matching statistics
+// of matching_statistics.hpp, and are loaded if the index has them.
+template <class bwt_type>
+class locator {
+   private:
+    const bwt_type* bwt_;
+    uint64_t size_;
+    uint64_t last_;
+    uint64_t ends_[257];
+    std::vector<uint64_t> end_pos_;
+    std::vector<uint64_t> end_sa_;
+    uint64_t starts_[257];
+    std::vector<uint64_t> start_pos_;
+    std::vector<uint64_t> start_sa_;
+    b_heap<> phi_;
+    uint64_t bytes_;
+
+    struct sample {
+        uint64_t row;
+        uint64_t sa;
+        uint8_t c;
+    };
+
+   public:
+    locator(const bwt_type& bwt, const std::string& path)
+        : bwt_(&bwt),
+          size_(0),
+          last_(0),
+          ends_(),
+          end_pos_(),
+          end_sa_(),
+          starts_(),
+          start_pos_(),
+          start_sa_(),
+          phi_(),
+          bytes_(0) {
+        container c(path);
+        if (c.find(section::sa_samples) == nullptr || c.find(section::phi) == nullptr) {
+            std::cerr << path << " has no locate support, see make_bwt -l" << std::endl;
+            exit(1);
+        }
+        std::fstream in_file;
+        in_file.open(path, std::ios::binary | std::ios::in);
+        c.seek(in_file, section::sa_samples);
+        in_file.read(reinterpret_cast<char*>(&size_), sizeof(uint64_t));
+        in_file.read(reinterpret_cast<char*>(&last_), sizeof(uint64_t));
+        in_file.read(reinterpret_cast<char*>(ends_), sizeof(uint64_t) * 257);
+        end_pos_.resize(ends_[256]);
+        end_sa_.resize(ends_[256]);
+        in_file.read(reinterpret_cast<char*>(end_pos_.data()), sizeof(uint64_t) * ends_[256]);
+        in_file.read(reinterpret_cast<char*>(end_sa_.data()), sizeof(uint64_t) * ends_[256]);
+        c.seek(in_file, section::phi);
+        bytes_ = sizeof(locator) + 2 * sizeof(uint64_t) * ends_[256] + phi_.load(in_file);
+        if (c.find(section::start_samples) != nullptr) {
+            c.seek(in_file, section::start_samples);
+            in_file.read(reinterpret_cast<char*>(starts_), sizeof(uint64_t) * 257);
+            start_pos_.resize(starts_[256]);
+            start_sa_.resize(starts_[256]);
+            in_file.read(reinterpret_cast<char*>(start_pos_.data()), sizeof(uint64_t) * starts_[256]);
+            in_file.read(reinterpret_cast<char*>(start_sa_.data()), sizeof(uint64_t) * starts_[256]);
+            bytes_ += 2 * sizeof(uint64_t) * starts_[256];
+        }
+        if (size_ != bwt.size()) {
+            std::cerr << "Locate samples in " << path << " do not match the index" << std::endl;
+            exit(1);
+        }
+    }
+
+    // Text positions of all occurrences of pattern, by decreasing BWT row: the
+    // sample of the last row of the range is followed by phi down to the first.
+    std::vector<uint64_t> locate(const std::string& pattern) const {
+        std::vector<uint64_t> res;
+        uint64_t a = 0;
+        uint64_t b = size_;
+        uint64_t t = last_;
+        for (size_t i = pattern.size() - 1; i < pattern.size(); i--) {
+            uint8_t c = pattern[i];
+            auto r = bwt_->rank_pair(a, b, c);
+            if (r.first == r.second) {
+                return res;
+            }
+            if (bwt_->at(b - 1) != c) {
+                // The last c before b ends a run of c.
+                const uint64_t* pos = end_pos_.data();
+                uint64_t j = std::upper_bound(pos + ends_[c], pos + ends_[c + 1], b - 1) - pos;
+                t = end_sa_[j - 1];
+            }
+            t = t ? t - 1 : size_ - 1;
+            a = bwt_->C(c) + r.first;
+            b = bwt_->C(c) + r.second;
+        }
+        res.reserve(b - a);
+        res.push_back(t);
+        for (uint64_t k = b - 1; k > a; k--) {
+            t = phi(t);
+            res.push_back(t);
+        }
+        return res;
+    }
+
+    // Row and suffix array value of the last c before row q, if BWT[q] != c.
+    bool run_end_before(uint64_t q, uint8_t c, uint64_t& row, uint64_t& sa) const {
+        const uint64_t* pos = end_pos_.data();
+        const uint64_t* p = std::lower_bound(pos + ends_[c], pos + ends_[c + 1], q);
+        if (p == pos + ends_[c]) {
+            return false;
+        }
+        row = p[-1];
+        sa = end_sa_[p - 1 - pos];
+        return true;
+    }
+
+    // Row and suffix array value of the first c after row q, if BWT[q] != c.
+    // Needs the run start samples, see has_start_samples.
+    bool run_start_after(uint64_t q, uint8_t c, uint64_t& row, uint64_t& sa) const {
+        const uint64_t* pos = start_pos_.data();
+        const uint64_t* p = std::upper_bound(pos + starts_[c], pos + starts_[c + 1], q);
+        if (p == pos + starts_[c + 1]) {
+            return false;
+        }
+        row = *p;
+        sa = start_sa_[p - pos];
+        return true;
+    }
+
+    bool has_start_samples() const { return starts_[256] > 0; }
+    // Suffix array value of the last row.
+    uint64_t last() const { return last_; }
+    uint64_t bytes() const { return bytes_; }
+
+    // Samples the suffix array of the index in path by walking LF over the
+    // whole BWT, and adds the samples to the container. terminator is the
+    // last symbol of the text and has to occur exactly once.
+    static void build(const bwt_type& bwt, const run_starts& runs, uint8_t terminator,
+                      const std::string& path) {
+        uint64_t n = bwt.size();
+        if (runs.size() != n) {
+            std::cerr << "Run starts do not match the index" << std::endl;
+            exit(1);
+        }
+        uint64_t k = terminator_row(bwt, terminator);
+        std::vector<sample> starts;
+        std::vector<sample> ends;
+        uint64_t sa = 0;
+        for (uint64_t step = 0; step < n; step++) {
+            auto r = bwt.inverse_select(k);
+            if (runs[k]) {
+                starts.push_back({k, sa, r.first});
+            }
+            if (k + 1 == n || runs[k + 1]) {
+                ends.push_back({k, sa, r.first});
+            }
+            k = bwt.C(r.first) + r.second;
+            sa = sa ? sa - 1 : n - 1;
+        }
+        auto by_row = [](const sample& a, const sample& b) { return a.row < b.row; };
+        std::sort(starts.begin(), starts.end(), by_row);
+        std::sort(ends.begin(), ends.end(), by_row);
+
+        // Run j starts right after run j - 1 ends.
+        uint64_t r = starts.size();
+        std::vector<std::pair<uint64_t, uint64_t>> phi_samples(r);
+        for (uint64_t j = 0; j < r; j++) {
+            phi_samples[j] = {starts[j].sa, ends[(j + r - 1) % r].sa};
+        }
+        std::sort(phi_samples.begin(), phi_samples.end());
+        b_heap<> phi(phi_samples.data(), r);
+        uint64_t last = ends.back().sa;
+
+        container_writer out(path);
+        out.begin(section::sa_samples);
+        out.write(reinterpret_cast<char*>(&n), sizeof(uint64_t));
+        out.write(reinterpret_cast<char*>(&last), sizeof(uint64_t));
+        write_by_symbol(out, ends);
+        out.end();
+        out.begin(section::phi);
+        phi.serialize(out, r);
+        out.end();
+        out.begin(section::start_samples);
+        write_by_symbol(out, starts);
+        out.end();
+        out.finalize();
+        std::cerr << "Sampled suffix array at " << r << " runs for locate" << std::endl;
+    }
+
+   private:
+    // Writes samples sorted by row as offsets of each symbol, followed by the
+    // rows and the suffix array values, ordered by symbol and then row.
+    static void write_by_symbol(container_writer& out, std::vector<sample>& samples) {
+        std::stable_sort(samples.begin(), samples.end(),
+                         [](const sample& a, const sample& b) { return a.c < b.c; });
+        uint64_t offsets[257] = {};
+        std::vector<uint64_t> rows;
+        std::vector<uint64_t> sa;
+        for (const auto& e : samples) {
+            offsets[e.c + 1]++;
+            rows.push_back(e.row);
+            sa.push_back(e.sa);
+        }
+        for (uint16_t c = 0; c < 256; c++) {
+            offsets[c + 1] += offsets[c];
+        }
+        out.write(reinterpret_cast<char*>(offsets), sizeof(uint64_t) * 257);
+        out.write(reinterpret_cast<char*>(rows.data()), sizeof(uint64_t) * rows.size());
+        out.write(reinterpret_cast<char*>(sa.data()), sizeof(uint64_t) * sa.size());
+    }
+
+    uint64_t phi(uint64_t t) const {
+        auto p = phi_.find(t + 1);
+        return p.second + (t - p.first);
+    }
+};
+}  // namespace bbwt
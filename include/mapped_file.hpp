@@ -0,0 +1,112 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+
+namespace bbwt {
+
+// stream:   read with one stream.
+// mmap:     map the index file, nothing is copied.
+// parallel: read with a pool of threads (see parallel_reader) to one arena.
+// huge:     as parallel, with the arena backed by huge pages when available.
+// paged:    as mmap, keeping resident block data within a budget (see pager).
+enum class load_mode { stream, mmap, parallel, huge, paged };
+
+// Read-only private mapping of a whole file.
+//
+// If padding is given, at least that many zeroed bytes are readable past the
+// end of the file contents, so blocks that read ahead (avx) stay in bounds.
+class mapped_file {
+   private:
+    uint8_t* data_;
+    uint64_t size_;
+    uint64_t mapped_;
+
+   public:
+    mapped_file() : data_(nullptr), size_(0), mapped_(0) {}
+
+    mapped_file(const std::string& path, uint64_t padding = 0,
+                int advice = MADV_NORMAL)
+        : data_(nullptr), size_(0), mapped_(0) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Opening " << path << " failed!" << std::endl;
+            exit(1);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            std::cerr << "Stat of " << path << " failed!" << std::endl;
+            exit(1);
+        }
+        size_ = st.st_size;
+        mapped_ = size_ + padding;
+        if (mapped_ == 0) {
+            close(fd);
+            return;
+        }
+        void* addr;
+        if (padding) {
+            // Reserve zero pages for the whole range and place the file on top.
+            addr = mmap(nullptr, mapped_, PROT_READ,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (addr != MAP_FAILED && size_ > 0) {
+                addr = mmap(addr, size_, PROT_READ, MAP_PRIVATE | MAP_FIXED,
+                            fd, 0);
+            }
+        } else {
+            addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (addr == MAP_FAILED) {
+            std::cerr << "Mapping " << path << " failed!" << std::endl;
+            exit(1);
+        }
+        data_ = reinterpret_cast<uint8_t*>(addr);
+        madvise(data_, size_, advice);
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    mapped_file(mapped_file&& other)
+        : data_(std::exchange(other.data_, nullptr)),
+          size_(std::exchange(other.size_, 0)),
+          mapped_(std::exchange(other.mapped_, 0)) {}
+
+    mapped_file& operator=(mapped_file&& other) {
+        if (data_ != nullptr) {
+            munmap(data_, mapped_);
+        }
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        mapped_ = std::exchange(other.mapped_, 0);
+        return *this;
+    }
+
+    ~mapped_file() {
+        if (data_ != nullptr) {
+            munmap(data_, mapped_);
+        }
+    }
+
+    // Hint the kernel about access to [offset, offset + length).
+    void advise(uint64_t offset, uint64_t length, int advice) const {
+        if (data_ == nullptr || length == 0) {
+            return;
+        }
+        uint64_t page = sysconf(_SC_PAGESIZE);
+        uint64_t start = offset - offset % page;
+        madvise(data_ + start, length + offset - start, advice);
+    }
+
+    uint8_t* data() const { return data_; }
+    uint64_t size() const { return size_; }
+};
+}  // namespace bbwt
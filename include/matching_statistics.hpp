@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "extract.hpp"
+#include "locate.hpp"
+
+#ifndef MS_CHUNK
+#define MS_CHUNK (uint64_t(1) << 20)
+#endif
+
+namespace bbwt {
+
+// Maximal exact match of a query: query[pos, pos + len) occurs count times in
+// the text, and can not be extended in either direction.
+struct mem {
+    uint64_t pos;
+    uint64_t len;
+    uint64_t count;
+};
+
+// Matching statistics in the style of PHONI (Boucher et al., 2021): ms[i] is
+// the length of the longest prefix of query[i..] that occurs in the text.
+//
+// The query is walked backwards through the BWT keeping a row q whose suffix
+// starts with the current match, and its suffix array value. While the BWT at
+// q is the next query symbol the walk is an LF step. Otherwise it restarts at
+// the closest occurrence of the symbol above or below q, which are a run end
+// and a run start with suffix array samples from the locator. Of the two, the
+// one sharing the longer prefix with the suffix of q is taken. Those prefixes
+// are compared against the query with random access to the text from the
+// extractor.
+//
+// The query is split into chunks of MS_CHUNK symbols that are walked in
+// parallel, each from an empty match at its end. A chunk is exact except where
+// matches reach its end, and those positions are walked again from the state
+// of the next chunk afterwards.
+template <class bwt_type>
+class matching_statistics {
+   private:
+    const bwt_type* bwt_;
+    const locator<bwt_type>* loc_;
+    const extractor<bwt_type>* ext_;
+    uint64_t size_;
+
+    // Walk state: the suffix of row q starts at text position t, and begins
+    // with the len query symbols after the current one.
+    struct state {
+        uint64_t q;
+        uint64_t t;
+        uint64_t len;
+    };
+
+   public:
+    matching_statistics(const bwt_type& bwt, const locator<bwt_type>& loc,
+                        const extractor<bwt_type>& ext)
+        : bwt_(&bwt), loc_(&loc), ext_(&ext), size_(bwt.size()) {
+        if (!loc.has_start_samples()) {
+            std::cerr << "Matching statistics need run start samples, rebuild the index with make_bwt -l"
+                      << std::endl;
+            exit(1);
+        }
+    }
+
+    // ms[i] for i < query.size(), with chunks walked by up to threads threads.
+    void compute(const std::string& query, uint64_t* ms, uint32_t threads = 1) const {
+        uint64_t m = query.size();
+        if (m == 0) {
+            return;
+        }
+        uint64_t chunks = (m + MS_CHUNK - 1) / MS_CHUNK;
+        std::vector<state> heads(chunks);
+        std::vector<std::thread> pool;
+        threads = threads ? threads : 1;
+        for (uint32_t w = 0; w < threads; w++) {
+            pool.emplace_back([&, w] {
+                for (uint64_t k = w; k < chunks; k += threads) {
+                    uint64_t s = k * MS_CHUNK;
+                    uint64_t e = s + MS_CHUNK < m ? s + MS_CHUNK : m;
+                    heads[k] = walk(query, ms, s, e, {size_ - 1, loc_->last(), 0});
+                }
+            });
+        }
+        for (auto& t : pool) {
+            t.join();
+        }
+        // Positions with matches to the end of chunk k are walked again from
+        // the exact state at the start of chunk k + 1.
+        for (uint64_t k = chunks - 1; k > 0; k--) {
+            uint64_t s = (k - 1) * MS_CHUNK;
+            uint64_t e = k * MS_CHUNK;
+            uint64_t redo = e;
+            while (redo > s && ms[redo - 1] == e - redo + 1) {
+                redo--;
+            }
+            if (redo == e) {
+                continue;
+            }
+            state st = walk(query, ms, redo, e, heads[k]);
+            if (redo == s) {
+                heads[k - 1] = st;
+            }
+        }
+    }
+
+    // MEMs of at least min_len symbols, with their number of occurrences.
+    std::vector<mem> mems(const std::string& query, uint64_t min_len, uint32_t threads = 1) const {
+        std::vector<uint64_t> ms(query.size());
+        compute(query, ms.data(), threads);
+        std::vector<mem> res;
+        for (uint64_t i = 0; i < query.size(); i++) {
+            // query[i, i + ms[i]) is left maximal if the match at i - 1 is not
+            // longer by one.
+            if (ms[i] >= min_len && ms[i] > 0 && (i == 0 || ms[i - 1] <= ms[i])) {
+                res.push_back({i, ms[i], 0});
+            }
+        }
+        std::vector<std::thread> pool;
+        threads = threads ? threads : 1;
+        for (uint32_t w = 0; w < threads; w++) {
+            pool.emplace_back([&, w] {
+                for (uint64_t j = w; j < res.size(); j += threads) {
+                    res[j].count = bwt_->count(query.substr(res[j].pos, res[j].len));
+                }
+            });
+        }
+        for (auto& t : pool) {
+            t.join();
+        }
+        return res;
+    }
+
+   private:
+    // Walks query[s, e) backwards from st, the state after query[e - 1], and
+    // returns the state at s.
+    state walk(const std::string& query, uint64_t* ms, uint64_t s, uint64_t e, state st) const {
+        for (uint64_t i = e; i > s;) {
+            i--;
+            uint8_t c = query[i];
+            uint64_t occ = (c == 255 ? size_ : bwt_->C(c + 1)) - bwt_->C(c);
+            if (occ == 0) [[unlikely]] {
+                st.len = 0;
+                ms[i] = 0;
+                continue;
+            }
+            auto r = bwt_->inverse_select(st.q);
+            if (r.first == c) {
+                st = {bwt_->C(c) + r.second, st.t ? st.t - 1 : size_ - 1, st.len + 1};
+                ms[i] = st.len;
+                continue;
+            }
+            uint64_t rank = bwt_->rank(st.q, c);
+            uint64_t row;
+            uint64_t t;
+            uint64_t best_len = 0;
+            uint64_t best_t = 0;
+            uint64_t best_rank = 0;
+            const char* next = query.data() + i + 1;
+            bool above = loc_->run_end_before(st.q, c, row, t);
+            if (above) {
+                best_len = common_prefix(t, next, st.len);
+                best_t = t;
+                best_rank = rank - 1;
+            }
+            if ((!above || best_len < st.len) && loc_->run_start_after(st.q, c, row, t)) {
+                uint64_t l = common_prefix(t, next, st.len);
+                if (!above || l > best_len) {
+                    best_len = l;
+                    best_t = t;
+                    best_rank = rank;
+                }
+            }
+            st = {bwt_->C(c) + best_rank, best_t ? best_t - 1 : size_ - 1, best_len + 1};
+            ms[i] = st.len;
+        }
+        return st;
+    }
+
+    // Length of the longest common prefix of the text from t and q[0, len).
+    // The text is extracted in doubling pieces, as the prefix is often short.
+    uint64_t common_prefix(uint64_t t, const char* q, uint64_t len) const {
+        uint64_t res = 0;
+        uint64_t piece = 16;
+        while (res < len) {
+            uint64_t n = piece < len - res ? piece : len - res;
+            std::string text = ext_->extract(t + res, n);
+            for (uint64_t j = 0; j < text.size(); j++) {
+                if (text[j] != q[res + j]) {
+                    return res + j;
+                }
+            }
+            res += text.size();
+            if (text.size() < n) {
+                return res;
+            }
+            piece *= 2;
+        }
+        return res;
+    }
+};
+}  // namespace bbwt
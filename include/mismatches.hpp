@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef MISMATCH_WINDOW
+#define MISMATCH_WINDOW 16
+#endif
+
+// Terminator and separator symbols, which are never substituted.
+#ifndef MISMATCH_SEPARATORS
+#define MISMATCH_SEPARATORS "$#"
+#endif
+
+namespace bbwt {
+
+// Counting of approximate occurrences, i.e. text substrings within Hamming
+// distance k of a pattern, by backtracking backward search.
+//
+// A search branches over every symbol of the alphabet while it has
+// mismatches left, with the ranks of all symbols at both ends of the range
+// from one rank_all each. Empty ranges are pruned. Once all k mismatches are
+// used the rest of the pattern is matched exactly with rank_pair.
+//
+// Backward search is cyclic, so substituting the terminator would count
+// strings that wrap from the end of the text to its start. Separators
+// would likewise count strings that span two texts. Neither are
+// substituted, but they still match where the pattern has them.
+
+// State of a backtracking search: [a, b) matches the suffix of pattern p
+// from i, with e mismatches.
+struct mismatch_node {
+    size_t p;
+    size_t i;
+    uint16_t e;
+    uint64_t a;
+    uint64_t b;
+};
+
+// Symbols of separators, that are not substituted, in a table by symbol.
+inline std::vector<bool> mismatch_separators(const std::string& separators) {
+    std::vector<bool> res(256);
+    for (char c : separators) {
+        res[uint8_t(c)] = true;
+    }
+    return res;
+}
+
+// Children of node n in the search for pattern, with up to k mismatches, are
+// passed to push. Symbols in fixed are only matched, not substituted.
+template <class bwt_type, class F>
+void branch_mismatches(const bwt_type& bwt, const std::string& pattern, uint16_t k,
+                       const std::vector<bool>& fixed, const mismatch_node& n, uint64_t* ra,
+                       uint64_t* rb, F push) {
+    uint8_t c = pattern[n.i - 1];
+    bwt.rank_all(n.a, ra);
+    bwt.rank_all(n.b, rb);
+    for (uint16_t s = 0; s < bwt.sigma(); s++) {
+        if (ra[s] == rb[s]) {
+            continue;
+        }
+        uint8_t sym = bwt.symbol(s);
+        if (sym != c && fixed[sym]) {
+            continue;
+        }
+        uint16_t e = n.e + (sym != c);
+        if (e <= k) {
+            uint64_t base = bwt.C(sym);
+            push({n.p, n.i - 1, e, base + ra[s], base + rb[s]});
+        }
+    }
+}
+
+// Number of occurrences of pattern with at most k mismatches, with none at
+// the symbols in separators.
+template <class bwt_type>
+uint64_t count_mismatches(const bwt_type& bwt, const std::string& pattern, uint16_t k,
+                          const std::string& separators = MISMATCH_SEPARATORS) {
+    std::vector<bool> fixed = mismatch_separators(separators);
+    std::vector<uint64_t> ra(bwt.sigma());
+    std::vector<uint64_t> rb(bwt.sigma());
+    std::vector<mismatch_node> stack = {{0, pattern.size(), 0, 0, bwt.size()}};
+    uint64_t res = 0;
+    while (stack.size()) {
+        mismatch_node n = stack.back();
+        stack.pop_back();
+        if (n.e == k) {
+            for (; n.i > 0 && n.a < n.b; n.i--) {
+                uint8_t c = pattern[n.i - 1];
+                auto r = bwt.rank_pair(n.a, n.b, c);
+                n.a = bwt.C(c) + r.first;
+                n.b = bwt.C(c) + r.second;
+            }
+            res += n.b - n.a;
+        } else if (n.i == 0) {
+            res += n.b - n.a;
+        } else {
+            branch_mismatches(bwt, pattern, k, fixed, n, ra.data(), rb.data(),
+                              [&](const mismatch_node& child) { stack.push_back(child); });
+        }
+    }
+    return res;
+}
+
+// out[j] = count_mismatches(bwt, patterns[j], k) for j < n.
+//
+// The searches for MISMATCH_WINDOW patterns are run breadth first together.
+// In each round the exact steps of all nodes without mismatches left are
+// taken with one rank_pair_batch call, so that their cache misses overlap,
+// and the other nodes are branched.
+template <class bwt_type>
+void count_mismatches_many(const bwt_type& bwt, const std::string* patterns, uint16_t k,
+                           uint64_t* out, size_t n,
+                           const std::string& separators = MISMATCH_SEPARATORS) {
+    std::vector<bool> fixed = mismatch_separators(separators);
+    std::vector<uint64_t> ra(bwt.sigma());
+    std::vector<uint64_t> rb(bwt.sigma());
+    std::vector<mismatch_node> nodes;
+    std::vector<mismatch_node> next;
+    std::vector<mismatch_node> exact;
+    std::vector<uint64_t> pos_a;
+    std::vector<uint64_t> pos_b;
+    std::vector<uint8_t> syms;
+    std::vector<std::pair<uint64_t, uint64_t>> ranks;
+    for (size_t w = 0; w < n; w += MISMATCH_WINDOW) {
+        size_t end = w + MISMATCH_WINDOW < n ? w + MISMATCH_WINDOW : n;
+        nodes.clear();
+        for (size_t p = w; p < end; p++) {
+            out[p] = patterns[p].size() ? 0 : bwt.size();
+            if (patterns[p].size()) {
+                nodes.push_back({p, patterns[p].size(), 0, 0, bwt.size()});
+            }
+        }
+        while (nodes.size()) {
+            next.clear();
+            exact.clear();
+            pos_a.clear();
+            pos_b.clear();
+            syms.clear();
+            auto push = [&](const mismatch_node& child) {
+                if (child.i == 0) {
+                    out[child.p] += child.b - child.a;
+                } else {
+                    next.push_back(child);
+                }
+            };
+            for (const auto& nd : nodes) {
+                if (nd.e < k) {
+                    branch_mismatches(bwt, patterns[nd.p], k, fixed, nd, ra.data(), rb.data(), push);
+                    continue;
+                }
+                exact.push_back(nd);
+                pos_a.push_back(nd.a);
+                pos_b.push_back(nd.b);
+                syms.push_back(patterns[nd.p][nd.i - 1]);
+            }
+            ranks.resize(exact.size());
+            bwt.rank_pair_batch(pos_a.data(), pos_b.data(), syms.data(), ranks.data(), exact.size());
+            for (size_t j = 0; j < exact.size(); j++) {
+                mismatch_node nd = exact[j];
+                uint64_t base = bwt.C(syms[j]);
+                nd.a = base + ranks[j].first;
+                nd.b = base + ranks[j].second;
+                nd.i--;
+                if (nd.a < nd.b) {
+                    push(nd);
+                }
+            }
+            std::swap(nodes, next);
+        }
+    }
+}
+}  // namespace bbwt
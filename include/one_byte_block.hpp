@@ -1,13 +1,17 @@
 #pragma once
 
+#include <algorithm>
 #include <immintrin.h>
 #include <cstdint>
+#include <optional>
+#include <utility>
 
 namespace bbwt {
 template <uint32_t block_size, class alphabet_type_, bool avx = false>
 class one_byte_block {
   public:
     typedef alphabet_type_ alphabet_type;
+    typedef typename alphabet_type::meta_type meta_type;
   private:
     static_assert(block_size <= ~uint32_t(0) >> 1);
 #ifndef __AVX2__
@@ -21,6 +25,7 @@ class one_byte_block {
    public:
     static const constexpr bool has_members = false;
     static const constexpr uint32_t cap = block_size;
+    static const constexpr uint32_t encoding = 3;
     static const constexpr uint32_t scratch_blocks = 2;
     static const constexpr uint32_t min_size = 2;
     static const constexpr uint32_t padding_bytes = avx ? 32 : 0;
@@ -41,8 +46,9 @@ class one_byte_block {
     one_byte_block& operator=(one_byte_block&& other) = delete;
     one_byte_block& operator=(const one_byte_block&) = delete;
 
-    uint32_t append(uint8_t head, uint32_t length, uint8_t** scratch) {
-        const uint16_t SHIFT = 8 - alphabet_type::width;
+    uint32_t append(uint8_t head, uint32_t length, uint8_t** scratch,
+                    const meta_type& m) {
+        const uint16_t SHIFT = 8 - m.width;
         const uint16_t LIMIT = uint16_t(1) << SHIFT;
         const uint16_t MASK = LIMIT - 1;
         uint64_t* offset = reinterpret_cast<uint64_t*>(scratch[0]);
@@ -57,13 +63,13 @@ class one_byte_block {
         return offset[0];
     }
 
-    uint8_t at(uint32_t location) const {
+    uint8_t at(uint32_t location, const meta_type& m) const {
 #ifdef __AVX2__
         if  constexpr (avx) {
-            return avx_at(location);
+            return avx_at(location, m);
         }
 #endif  
-        const uint16_t SHIFT = 8 - alphabet_type::width;
+        const uint16_t SHIFT = 8 - m.width;
         const uint16_t LIMIT = uint16_t(1) << SHIFT;
         const uint16_t MASK = LIMIT - 1;
         const uint8_t* data = reinterpret_cast<const uint8_t*>(this);
@@ -78,13 +84,13 @@ class one_byte_block {
         }
     }
 
-    uint32_t rank(uint8_t c, uint32_t location) const {
+    uint32_t rank(uint8_t c, uint32_t location, const meta_type& m) const {
 #ifdef __AVX2__
         if constexpr (avx) {
-            return avx_rank(c, location);
+            return avx_rank(c, location, m);
         }
 #endif
-        const uint16_t SHIFT = 8 - alphabet_type::width;
+        const uint16_t SHIFT = 8 - m.width;
         const uint16_t LIMIT = uint16_t(1) << SHIFT;
         const uint16_t MASK = LIMIT - 1;
         const uint8_t* data = reinterpret_cast<const uint8_t*>(this);
@@ -103,6 +109,188 @@ class one_byte_block {
         }
     }
 
+    // Number of symbols before location that are smaller than some symbol.
+    // Run lengths are masked with less, see meta_type::less_masks.
+    uint32_t rank_less(const uint32_t* less, uint32_t location, const meta_type& m) const {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(this);
+        const uint16_t SHIFT = 8 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        uint32_t res = 0;
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current = data[i] >> SHIFT;
+            uint8_t length = 1 + (data[i++] & MASK);
+            if (location >= length) [[likely]] {
+                location -= length;
+                res += length & less[current];
+            } else {
+                res += location & less[current];
+                return res;
+            }
+        }
+    }
+
+    // {at(location, m), rank(at(location, m), location, m)} with one scan.
+    std::pair<uint8_t, uint32_t> inverse_select(uint32_t location, const meta_type& m) const {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(this);
+        const uint16_t SHIFT = 8 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        uint32_t counts[256];
+        std::fill_n(counts, uint16_t(1) << m.width, 0);
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current = data[i] >> SHIFT;
+            uint8_t length = 1 + (data[i++] & MASK);
+            if (location >= length) [[likely]] {
+                location -= length;
+                counts[current] += length;
+            } else {
+                return {current, counts[current] + location};
+            }
+        }
+    }
+
+    // Adds the number of occurrences of each symbol before location to out.
+    void rank_all(uint32_t location, uint64_t* out, const meta_type& m) const {
+        const uint16_t SHIFT = 8 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(this);
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current = data[i] >> SHIFT;
+            uint8_t length = 1 + (data[i++] & MASK);
+            if (location >= length) [[likely]] {
+                location -= length;
+                out[current] += length;
+            } else {
+                out[current] += location;
+                return;
+            }
+        }
+    }
+
+    // Adds the number of occurrences of each symbol before a to ra and before
+    // b to rb, for a <= b, with one scan.
+    void rank_all_pair(uint32_t a, uint32_t b, uint64_t* ra, uint64_t* rb,
+                       const meta_type& m) const {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(this);
+        const uint16_t SHIFT = 8 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        uint32_t i = 0;
+        uint8_t current;
+        uint8_t length;
+        while (true) {
+            current = data[i] >> SHIFT;
+            length = 1 + (data[i++] & MASK);
+            if (a >= length) [[likely]] {
+                a -= length;
+                b -= length;
+                ra[current] += length;
+                rb[current] += length;
+            } else {
+                break;
+            }
+        }
+        ra[current] += a;
+        while (b >= length) {
+            b -= length;
+            rb[current] += length;
+            current = data[i] >> SHIFT;
+            length = 1 + (data[i++] & MASK);
+        }
+        rb[current] += b;
+    }
+
+    // {rank(c, a, m), rank(c, b, m)} with a scan to a only, if [a, b) lies
+    // inside one run of the block. Otherwise b may be past the end of the block.
+    std::optional<std::pair<uint32_t, uint32_t>> run_rank(uint8_t c, uint32_t a, uint32_t b,
+                                                          const meta_type& m) const {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(this);
+        const uint16_t SHIFT = 8 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        uint32_t res = 0;
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current = data[i] >> SHIFT;
+            uint8_t length = 1 + (data[i++] & MASK);
+            if (a >= length) [[likely]] {
+                a -= length;
+                b -= length;
+                res += current == c ? length : 0;
+            } else if (b > length) {
+                return std::nullopt;
+            } else if (current == c) {
+                return std::pair<uint32_t, uint32_t>(res + a, res + b);
+            } else {
+                return std::pair<uint32_t, uint32_t>(res, res);
+            }
+        }
+    }
+
+    // {rank(c, a, m), rank(c, b, m)} for a <= b, with one scan.
+    std::pair<uint32_t, uint32_t> rank_pair(uint8_t c, uint32_t a, uint32_t b,
+                                            const meta_type& m) const {
+#ifdef __AVX2__
+        if constexpr (avx) {
+            return {avx_rank(c, a, m), avx_rank(c, b, m)};
+        }
+#endif
+        const uint16_t SHIFT = 8 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(this);
+        uint32_t res = 0;
+        uint32_t i = 0;
+        uint8_t current;
+        uint8_t length;
+        while (true) {
+            current = data[i] >> SHIFT;
+            length = 1 + (data[i++] & MASK);
+            if (a >= length) [[likely]] {
+                a -= length;
+                b -= length;
+                res += current == c ? length : 0;
+            } else {
+                break;
+            }
+        }
+        uint32_t res_a = res + (current == c ? a : 0);
+        while (b >= length) {
+            b -= length;
+            res += current == c ? length : 0;
+            current = data[i] >> SHIFT;
+            length = 1 + (data[i++] & MASK);
+        }
+        return {res_a, res + (current == c ? b : 0)};
+    }
+
+    // Position of the occurrence of c with rank k, the inverse of rank. The
+    // block has to contain more than k occurrences of c.
+    uint32_t select(uint8_t c, uint32_t k, const meta_type& m) const {
+        const uint16_t SHIFT = 8 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(this);
+        uint32_t location = 0;
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current = data[i] >> SHIFT;
+            uint8_t length = 1 + (data[i++] & MASK);
+            if (current == c) {
+                if (k < length) {
+                    return location + k;
+                }
+                k -= length;
+            }
+            location += length;
+        }
+    }
+
     uint64_t commit(uint8_t** scratch) {
         uint64_t bytes = reinterpret_cast<uint64_t*>(scratch[0])[0];
         uint8_t* data = reinterpret_cast<uint8_t*>(this);
@@ -112,12 +300,14 @@ class one_byte_block {
     }
 
     void clear() {}
-    static void write_statics(std::fstream&) {return; }
-    static uint64_t load_statics(std::fstream&) {return 0; }
+    template <class o_t>
+    static void write_statics(o_t&) {return; }
+    template <class i_t>
+    static uint64_t load_statics(i_t&) {return 0; }
 
-    void print(uint32_t sb) const {
+    void print(uint32_t sb, const meta_type& m) const {
         const uint8_t* data = reinterpret_cast<const uint8_t*>(this);
-        const uint16_t SHIFT = 8 - alphabet_type::width;
+        const uint16_t SHIFT = 8 - m.width;
         const uint16_t LIMIT = uint16_t(1) << SHIFT;
         const uint16_t MASK = LIMIT - 1;
         uint32_t i = 0;
@@ -143,8 +333,8 @@ class one_byte_block {
         return _mm_extract_epi64(low, 0) + _mm_extract_epi64(low, 1);
     }
 
-    uint8_t avx_at(uint32_t location) const {
-        const uint16_t SHIFT = 8 - alphabet_type::width;
+    uint8_t avx_at(uint32_t location, const meta_type& m) const {
+        const uint16_t SHIFT = 8 - m.width;
         const uint16_t LIMIT = uint16_t(1) << SHIFT;
         const uint16_t MASK = LIMIT - 1;
         const __m256i VMASK = _mm256_set1_epi8(MASK);
@@ -174,13 +364,13 @@ class one_byte_block {
         return 0;
     }
 
-    uint32_t avx_rank(uint8_t c, uint32_t location) const {
+    uint32_t avx_rank(uint8_t c, uint32_t location, const meta_type& m) const {
         const __m256i* vdata = reinterpret_cast<const __m256i*>(this);
         const __m256i ccomp = _mm256_set1_epi8(c);
-        const uint16_t SHIFT = 8 - alphabet_type::width;
+        const uint16_t SHIFT = 8 - m.width;
         const uint16_t LIMIT = uint16_t(1) << SHIFT;
         const uint16_t MASK = LIMIT - 1;
-        const __m256i CMASK = _mm256_set1_epi8((uint16_t(1) << alphabet_type::width) - 1);
+        const __m256i CMASK = _mm256_set1_epi8((uint16_t(1) << m.width) - 1);
         const __m256i VMASK = _mm256_set1_epi8(MASK);
 
         uint32_t res = 0;
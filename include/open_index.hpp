@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <variant>
+
+#include "container.hpp"
+#include "mapped_file.hpp"
+#include "types.hpp"
+
+namespace bbwt {
+
+template <class... bwt_types>
+struct index_list {
+    template <class... others>
+    index_list<bwt_types..., others...> operator+(index_list<others...>) const;
+
+    typedef std::variant<std::unique_ptr<bwt_types>...> variant_type;
+};
+
+template <uint32_t... block_sizes>
+using block_index_list = index_list<two_byte<block_sizes>..., vbyte<block_sizes>...,
+                                    dyn<block_sizes>..., t_dyn<block_sizes>...>;
+
+template <uint32_t... run_counts>
+using run_index_list = index_list<run<run_counts>...>;
+
+// Index types that open_index can return.
+typedef decltype(block_index_list<2048, 4096, 8192, 16384>() +
+                 run_index_list<16, 32, 64>()) supported_indexes;
+
+// Handle to an index of any supported type.
+//
+// Queries go through visit, which dispatches on the index type once and calls
+// f with the concrete index. Do whole batches of queries inside f.
+class index_handle {
+   public:
+    typedef supported_indexes::variant_type variant_type;
+
+   private:
+    variant_type index_;
+
+   public:
+    index_handle(variant_type&& index) : index_(std::move(index)) {}
+
+    template <class F>
+    decltype(auto) visit(F&& f) {
+        return std::visit([&](auto& bwt) -> decltype(auto) { return f(*bwt); },
+                          index_);
+    }
+
+    template <class F>
+    decltype(auto) visit(F&& f) const {
+        return std::visit(
+            [&](const auto& bwt) -> decltype(auto) { return f(*bwt); },
+            index_);
+    }
+
+    uint64_t size() const {
+        return visit([](const auto& bwt) { return bwt.size(); });
+    }
+
+    uint64_t bytes() const {
+        return visit([](const auto& bwt) { return bwt.bytes(); });
+    }
+};
+
+template <class bwt_type>
+bool matches(const container& c) {
+    return c.kind() == bwt_type::kind &&
+           c.encoding() == bwt_type::block_type::encoding &&
+           c.block_size() == bwt_type::block_type::cap;
+}
+
+template <class... bwt_types>
+index_handle::variant_type open_as(const std::string& path, load_mode mode,
+                                   index_list<bwt_types...>) {
+    container c(path);
+    index_handle::variant_type res;
+    bool found = ((matches<bwt_types>(c) &&
+                   (res = std::make_unique<bwt_types>(path, mode), true)) ||
+                  ...);
+    if (!found) {
+        std::cerr << path << " has no supported index type (kind "
+                  << static_cast<uint32_t>(c.kind()) << ", encoding "
+                  << c.encoding() << ", block size " << c.block_size() << ")"
+                  << std::endl;
+        exit(1);
+    }
+    return res;
+}
+
+// Opens a container index of any type in supported_indexes.
+inline index_handle open_index(const std::string& path,
+                               load_mode mode = load_mode::stream) {
+    return index_handle(open_as(path, mode, supported_indexes()));
+}
+}  // namespace bbwt
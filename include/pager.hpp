@@ -0,0 +1,141 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#ifndef PAGE_BUDGET
+#define PAGE_BUDGET 0
+#endif
+
+#ifndef PAGE_GROUP
+#define PAGE_GROUP 1024
+#endif
+
+namespace bbwt {
+
+// Keeps the resident part of a read-only file mapping within a byte budget.
+//
+// The mapping is split into units (groups of blocks). Units are faulted in by
+// the kernel on first touch. When the resident units exceed the budget, the
+// least recently used ones are dropped with MADV_DONTNEED. Concurrent readers
+// of a dropped unit are safe, the pages are just read back from the file.
+//
+// Recency is an epoch stamp per unit, 0 for units that are not resident. The
+// epoch only advances when a unit is faulted in, so touching a resident unit is
+// a load and usually no store. Stamps are refreshed with a compare and swap,
+// so a unit that was evicted meanwhile is faulted in again and counted.
+//
+// Eviction candidates are kept in a min-heap of (stamp, unit) under the lock,
+// one entry per resident unit. Stamps refreshed since an entry was pushed are
+// only seen when it comes up for eviction, and it is then pushed again with
+// the new stamp.
+class pager {
+   private:
+    uint8_t* base_;
+    std::vector<std::pair<uint64_t, uint64_t>> units_;
+    std::unique_ptr<std::atomic<uint64_t>[]> stamps_;
+    std::priority_queue<std::pair<uint64_t, uint64_t>, std::vector<std::pair<uint64_t, uint64_t>>,
+                        std::greater<std::pair<uint64_t, uint64_t>>>
+        lru_;
+    std::atomic<uint64_t> epoch_;
+    uint64_t resident_;
+    uint64_t budget_;
+    uint64_t faults_;
+    uint64_t evictions_;
+    uint64_t page_;
+    std::mutex mutex_;
+
+   public:
+    // units are (offset, size) ranges relative to base. Budget 0 is unlimited.
+    pager(uint8_t* base, std::vector<std::pair<uint64_t, uint64_t>>&& units,
+          uint64_t budget = PAGE_BUDGET)
+        : base_(base),
+          units_(std::move(units)),
+          stamps_(new std::atomic<uint64_t>[units_.size()]),
+          lru_(),
+          epoch_(1),
+          resident_(0),
+          budget_(budget),
+          faults_(0),
+          evictions_(0),
+          page_(sysconf(_SC_PAGESIZE)) {
+        for (uint64_t i = 0; i < units_.size(); i++) {
+            stamps_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    pager(const pager&) = delete;
+    pager& operator=(const pager&) = delete;
+
+    void touch(uint64_t unit) {
+        uint64_t epoch = epoch_.load(std::memory_order_relaxed);
+        uint64_t stamp = stamps_[unit].load(std::memory_order_relaxed);
+        if (stamp == epoch) [[likely]] {
+            return;
+        }
+        if (stamp != 0 &&
+            stamps_[unit].compare_exchange_strong(stamp, epoch, std::memory_order_relaxed)) {
+            return;
+        }
+        fault(unit);
+    }
+
+    void set_budget(uint64_t budget) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        budget_ = budget;
+        evict(units_.size());
+    }
+
+    uint64_t budget() const { return budget_; }
+    uint64_t resident() const { return resident_; }
+    uint64_t faults() const { return faults_; }
+    uint64_t evictions() const { return evictions_; }
+
+   private:
+    void fault(uint64_t unit) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stamps_[unit].load(std::memory_order_relaxed) != 0) {
+            return;
+        }
+        uint64_t epoch = epoch_.load(std::memory_order_relaxed) + 1;
+        epoch_.store(epoch, std::memory_order_relaxed);
+        stamps_[unit].store(epoch, std::memory_order_relaxed);
+        lru_.push({epoch, unit});
+        resident_ += units_[unit].second;
+        faults_++;
+        evict(unit);
+    }
+
+    // Drop least recently used units other than keep until within budget.
+    void evict(uint64_t keep) {
+        while (budget_ && resident_ > budget_ && lru_.size()) {
+            auto [stamp, victim] = lru_.top();
+            if (victim == keep) {
+                // keep has the newest stamp, so no other unit is left.
+                return;
+            }
+            lru_.pop();
+            // Fails if the unit was touched since the entry was pushed.
+            if (!stamps_[victim].compare_exchange_strong(stamp, 0, std::memory_order_relaxed)) {
+                lru_.push({stamp, victim});
+                continue;
+            }
+            resident_ -= units_[victim].second;
+            evictions_++;
+            uint64_t offset = units_[victim].first;
+            uint64_t start = offset - offset % page_;
+            madvise(base_ + start, units_[victim].second + offset - start,
+                    MADV_DONTNEED);
+        }
+    }
+};
+}  // namespace bbwt
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef LOAD_THREADS
+#define LOAD_THREADS 0
+#endif
+
+namespace bbwt {
+
+// Reads byte ranges of a file into memory with a pool of threads issuing
+// preads. With enough threads this keeps the device queue full, which a single
+// stream does not.
+//
+// Thread count is given by LOAD_THREADS, 0 for hardware concurrency.
+class parallel_reader {
+   private:
+    static const constexpr uint64_t CHUNK = uint64_t(1) << 22;
+
+    std::string path_;
+    int fd_;
+    uint32_t threads_;
+
+   public:
+    parallel_reader(const std::string& path, uint32_t threads = LOAD_THREADS)
+        : path_(path), fd_(open(path.c_str(), O_RDONLY)), threads_(threads) {
+        if (fd_ < 0) {
+            std::cerr << "Opening " << path << " failed!" << std::endl;
+            exit(1);
+        }
+        if (threads_ == 0) {
+            threads_ = std::thread::hardware_concurrency();
+        }
+        if (threads_ == 0) {
+            threads_ = 1;
+        }
+    }
+
+    parallel_reader(const parallel_reader&) = delete;
+    parallel_reader& operator=(const parallel_reader&) = delete;
+
+    ~parallel_reader() { close(fd_); }
+
+    uint64_t size() const {
+        off_t end = lseek(fd_, 0, SEEK_END);
+        return end < 0 ? 0 : end;
+    }
+
+    // Reads [offset, offset + bytes) of the file to dst, split in chunks over
+    // the thread pool. Small reads are done on the calling thread.
+    void read(uint8_t* dst, uint64_t offset, uint64_t bytes) const {
+        uint64_t chunks = (bytes + CHUNK - 1) / CHUNK;
+        uint32_t n_threads = chunks < threads_ ? chunks : threads_;
+        if (n_threads <= 1) {
+            read_range(dst, offset, bytes);
+            return;
+        }
+        std::atomic<uint64_t> next(0);
+        auto work = [&]() {
+            for (uint64_t c = next++; c < chunks; c = next++) {
+                uint64_t start = c * CHUNK;
+                uint64_t len = bytes - start < CHUNK ? bytes - start : CHUNK;
+                read_range(dst + start, offset + start, len);
+            }
+        };
+        std::vector<std::thread> pool;
+        for (uint32_t t = 1; t < n_threads; t++) {
+            pool.emplace_back(work);
+        }
+        work();
+        for (auto& t : pool) {
+            t.join();
+        }
+    }
+
+   private:
+    void read_range(uint8_t* dst, uint64_t offset, uint64_t bytes) const {
+        while (bytes) {
+            ssize_t n = pread(fd_, dst, bytes, offset);
+            if (n <= 0) {
+                std::cerr << "Reading " << path_ << " failed!" << std::endl;
+                exit(1);
+            }
+            dst += n;
+            offset += n;
+            bytes -= n;
+        }
+    }
+};
+}  // namespace bbwt
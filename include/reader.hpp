@@ -5,6 +5,24 @@
 #include <cstdint>
 
 namespace bbwt {
+
+// Calls f(head, length) for each run of equal bytes in data. Runs longer than
+// fits in 32 bits are split.
+template <class F>
+void for_each_run(const uint8_t* data, uint64_t size, F f) {
+    const uint64_t MAX_RUN = ~uint32_t(0);
+    uint64_t i = 0;
+    while (i < size) {
+        uint8_t head = data[i];
+        uint64_t j = i + 1;
+        while (j < size && data[j] == head && j - i < MAX_RUN) {
+            j++;
+        }
+        f(head, uint32_t(j - i));
+        i = j;
+    }
+}
+
 template<class alphabet_type>
 class file_reader {
    private:
@@ -50,7 +68,10 @@ class file_reader {
         }
 
         bool operator==(const if_iterator& rhs) const {
-            return head_ == rhs.head_ && length_ == rhs.length_ && eof_ == rhs.eof_;
+            if (length_ == 0 || rhs.length_ == 0) {
+                return length_ == rhs.length_;
+            }
+            return head_ == rhs.head_ && length_ == rhs.length_;
         }
 
         bool operator!=(const if_iterator& rhs) const {
@@ -88,7 +109,7 @@ class file_reader {
         return if_iterator(c, in);
     }
 
-    if_iterator end() { return if_iterator('\0', in); }
+    if_iterator end() { return if_iterator('\0', in, true); }
 };
 
 template<class alphabet_type>
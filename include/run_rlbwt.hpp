@@ -1,16 +1,39 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <random>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <fstream>
+#include <tuple>
 #include <utility>
 
 #include "b_heap.hpp"
-#include "custom_alphabet.hpp"
 #include "alphabet.hpp"
+#include "arena.hpp"
+#include "container.hpp"
+#include "interval_cache.hpp"
+#include "kmer_table.hpp"
+#include "locate.hpp"
+#include "mapped_file.hpp"
+#include "parallel_reader.hpp"
+
+#ifndef RANK_GROUP
+#define RANK_GROUP 16
+#endif
+
+#ifndef COUNT_WINDOW
+#define COUNT_WINDOW 16
+#endif
+
+// Longest range for which count checks whether the range lies in one run
+// before searching the heap for its end. Longer ranges rarely do.
+#ifndef RUN_SHORTCUT
+#define RUN_SHORTCUT 64
+#endif
 
 namespace bbwt {
 template <class bwt_type>
@@ -19,51 +42,58 @@ class run_rlbwt_builder {
     typedef typename bwt_type::alphabet_type alphabet_type;
     typedef typename bwt_type::block_type block_type;
 
+    typename alphabet_type::meta_type alpha_;
     uint64_t char_counts_[257];
     uint32_t run_count_;
-    std::string prefix_;
-    std::string suffix_;
-    alphabet_type cumulative_;
+    std::vector<uint8_t> cumulative_;
     std::vector<std::pair<uint64_t, uint64_t>> block_offsets_;
     uint64_t elems_;
     uint8_t** scratch_;
     block_type current_block_;
     uint64_t block_elems_;
     uint64_t offset_;
-    std::fstream out_;
+    container_writer out_;
+    std::unique_ptr<run_starts> runs_;
 
    public:
-    run_rlbwt_builder(std::string out_file)
-        : char_counts_(),
+    // counts are the symbol counts of the whole input, see symbol_counts.
+    run_rlbwt_builder(std::string out_file, const symbol_counts& counts)
+        : alpha_(counts),
+          char_counts_(),
           run_count_(0),
-          cumulative_(),
+          cumulative_(alpha_.size()),
           block_offsets_(),
           elems_(0),
           current_block_(),
           block_elems_(0),
-          offset_(alphabet_type::size()) {
-        size_t loc = out_file.find_last_of('.');
-        if (loc == std::string::npos) {
-            prefix_ = out_file;
-            suffix_ = "";
-        } else {
-            prefix_ = out_file.substr(0, loc);
-            suffix_ = out_file.substr(loc);
-        }
-        out_.open(prefix_ + "_data" + suffix_, std::ios::binary | std::ios::out);
+          offset_(alpha_.size()),
+          out_(out_file, bwt_type::kind, block_type::encoding, block_type::cap),
+          runs_() {
+        out_.begin(section::statics);
+        alpha_.write_statics(out_);
+        block_type::write_statics(out_);
+        out_.end();
+        out_.begin(section::block_data, HUGE_ALIGN);
         scratch_ =
             (uint8_t**)malloc(block_type::scratch_blocks * sizeof(uint8_t*));
         for (size_t i = 0; i < block_type::scratch_blocks; i++) {
             scratch_[i] = (uint8_t*)calloc(block_type::scratch_size(i), 1);
         }
-        out_.write(reinterpret_cast<char*>(&cumulative_), alphabet_type::size());
+        out_.write(reinterpret_cast<char*>(cumulative_.data()), alpha_.size());
     }
 
+    // Keeps the positions where runs start, for locator::build.
+    void track_runs() { runs_ = std::make_unique<run_starts>(); }
+    const run_starts& runs() const { return *runs_; }
+
     void append(uint8_t head, uint32_t length) {
+        if (runs_) {
+            runs_->add(head, length);
+        }
         char_counts_[head] += length;
-        head = alphabet_type::convert(head);
-        cumulative_.add(head, length);
-        current_block_.append(head, length, scratch_);
+        head = alpha_.convert(head);
+        reinterpret_cast<alphabet_type*>(cumulative_.data())->add(head, length, alpha_);
+        current_block_.append(head, length, scratch_, alpha_);
         block_elems_ += length;
         ++run_count_;
         if (run_count_ >= block_type::cap) {
@@ -75,7 +105,7 @@ class run_rlbwt_builder {
         if (block_elems_) {
             commit(true);
         }
-        out_.close();
+        out_.end();
         uint64_t p_v = 0;
         for (size_t i = 0; i < 257; i++) {
             uint64_t tmp = char_counts_[i];
@@ -120,8 +150,8 @@ class run_rlbwt_builder {
             std::memset(scratch_[i], 0, block_type::scratch_size(i));
         }
         if (!last_block) {
-            out_.write(reinterpret_cast<char*>(&cumulative_), alphabet_type::size());
-            offset_ += alphabet_type::size();
+            out_.write(reinterpret_cast<char*>(cumulative_.data()), alpha_.size());
+            offset_ += alpha_.size();
         }
     }
 
@@ -130,16 +160,14 @@ class run_rlbwt_builder {
                   << " Made " << block_offsets_.size() << " blocks\n"
                   << " containing a total of " << elems_ << " elements." << std::endl;
 
-        std::fstream out;
-        out.open(prefix_ + suffix_, std::ios::binary | std::ios::out);
-        alphabet_type::write_statics(out);
-        block_type::write_statics(out);
-        out.write(reinterpret_cast<char*>(&offset_), sizeof(uint64_t));
-        out.write(reinterpret_cast<char*>(&elems_), sizeof(uint64_t));
         b_heap<> b_h(block_offsets_.data(), block_offsets_.size());
-        b_h.serialize(out, block_offsets_.size());
-        out.write(reinterpret_cast<char*>(char_counts_), sizeof(uint64_t) * 257);
-        out.close();
+        out_.begin(section::heap);
+        b_h.serialize(out_, block_offsets_.size());
+        out_.end();
+        out_.begin(section::char_counts);
+        out_.write(reinterpret_cast<char*>(char_counts_), sizeof(uint64_t) * 257);
+        out_.end();
+        out_.finalize(elems_, block_offsets_.size());
     }
 };
 
@@ -149,6 +177,7 @@ class run_rlbwt {
     typedef block_type_ block_type;
     typedef block_type::alphabet_type alphabet_type;
     typedef run_rlbwt_builder<run_rlbwt> builder;
+    static const constexpr index_kind kind = index_kind::run;
 
    private:
     uint64_t size_;
@@ -158,45 +187,40 @@ class run_rlbwt {
     b_heap<> b_h_;
     uint8_t* data_;
     std::vector<std::pair<uint64_t, uint64_t>> skips;
+    typename alphabet_type::meta_type alpha_;
+    load_mode mode_;
+    mapped_file root_map_;
+    mapped_file data_map_;
+    arena arena_;
+    kmer_table kmers_;
+    interval_cache* cache_;
+    // less_sums of the block partial sums, after build_less_sums.
+    std::vector<uint64_t> less_sums_;
 
    public:
-    run_rlbwt(std::string path) : bytes_(sizeof(run_rlbwt)) {
-        std::fstream in_file;
-        in_file.open(path, std::ios::binary | std::ios::in);
-        if (in_file.fail()) {
-            std::cerr << "Opening " << path << " failed!" << std::endl;
-            exit(1);
+    run_rlbwt(std::string path, load_mode mode = load_mode::stream)
+        : bytes_(sizeof(run_rlbwt)),
+          alpha_(),
+          mode_(mode),
+          root_map_(),
+          data_map_(),
+          arena_(),
+          kmers_(),
+          cache_(nullptr),
+          less_sums_() {
+        // Run blocks are not paged, map them instead.
+        if (mode_ == load_mode::paged) {
+            std::cerr << "Paged mode is not supported for run indexes, " << path
+                      << " is memory mapped without a page budget" << std::endl;
+            mode_ = load_mode::mmap;
         }
-        bytes_ += alphabet_type::load_statics(in_file);
-        bytes_ += block_type::load_statics(in_file);
-        uint64_t data_bytes;
-        in_file.read(reinterpret_cast<char*>(&data_bytes), sizeof(uint64_t));
-        in_file.read(reinterpret_cast<char*>(&size_), sizeof(uint64_t));
-
-        bytes_ += b_h_.load(in_file);
-
-        in_file.read(reinterpret_cast<char*>(char_counts_), sizeof(uint64_t) * 257);
-        in_file.close();
-
-        std::string prefix;
-        std::string suffix;
-        size_t loc = path.find_last_of('.');
-        if (loc == std::string::npos) {
-            prefix = path;
-            suffix = "";
+        if (container::is_container(path)) {
+            load_container(path);
+            kmers_.load(path);
+            bytes_ += kmers_.bytes();
         } else {
-            prefix = path.substr(0, loc);
-            suffix = path.substr(loc);
-        }
-        in_file.open(prefix + "_data" + suffix, std::ios::binary | std::ios::in);
-        if (in_file.fail()) {
-            std::cerr << "opening " << prefix << "_data" << suffix << " failed!" << std::endl;
-            exit(1);
+            load_legacy(path);
         }
-        data_ = (uint8_t*)std::malloc(data_bytes);
-        in_file.read(reinterpret_cast<char*>(data_), data_bytes);
-        bytes_ += data_bytes;
-        in_file.close();
 
         if constexpr (f_index) {
             build_f_index();
@@ -213,7 +237,15 @@ class run_rlbwt {
         block_count_ = std::exchange(other.block_count_, 0);
         data_ = std::exchange(other.data_, nullptr);
         b_h_ = other.b_h_;
+        alpha_ = std::move(other.alpha_);
+        mode_ = other.mode_;
+        root_map_ = std::move(other.root_map_);
+        data_map_ = std::move(other.data_map_);
+        arena_ = std::move(other.arena_);
         std::memcpy(char_counts_, other.char_counts_, sizeof(uint64_t) * 257);
+        kmers_ = std::move(other.kmers_);
+        cache_ = std::exchange(other.cache_, nullptr);
+        less_sums_ = std::move(other.less_sums_);
     }
 
     run_rlbwt& operator=(run_rlbwt&& other) {
@@ -222,12 +254,20 @@ class run_rlbwt {
         block_count_ = std::exchange(other.block_count_, 0);
         data_ = std::exchange(other.data_, nullptr);
         b_h_ = other.b_h_;
+        alpha_ = std::move(other.alpha_);
+        mode_ = other.mode_;
+        root_map_ = std::move(other.root_map_);
+        data_map_ = std::move(other.data_map_);
+        arena_ = std::move(other.arena_);
         std::memcpy(char_counts_, other.char_counts_, sizeof(uint64_t) * 257);
+        kmers_ = std::move(other.kmers_);
+        cache_ = std::exchange(other.cache_, nullptr);
+        less_sums_ = std::move(other.less_sums_);
         return *this;
     }
 
     ~run_rlbwt() {
-        if (data_ != nullptr) {
+        if (data_ != nullptr && mode_ == load_mode::stream) {
             std::free(data_);
         }
     }
@@ -236,46 +276,339 @@ class run_rlbwt {
         if (i >= size_) [[unlikely]] {
             return 0;
         }
-        auto count = b_h_.find(i);
+        // find(i) gives the previous block if i is the first position of a block.
+        auto count = b_h_.find(i + 1);
         i -= count.first;
         block_type* block = reinterpret_cast<block_type*>(data_ + count.second);
-        return alphabet_type::revert(block->at(i));
+        return alpha_.revert(block->at(i, alpha_));
     }
 
     uint64_t count(const std::string& pattern) const {
-        uint8_t c = pattern[pattern.size() - 1];
+        size_t m = pattern.size();
+        uint8_t c = pattern[m - 1];
         uint64_t a = char_counts_[c];
         uint64_t b = char_counts_[uint16_t(c) + 1];
-        uint64_t ret = b  - a;
-        for (size_t i = pattern.size() - 2; i < pattern.size() && ret > 0; i--) {
+        size_t i = m - 1;
+        uint64_t cached = cache_ ? cache_->find(pattern, a, b) : 0;
+        if (cached) {
+            i = m - cached;
+        } else if (kmers_.covers(m)) {
+            i = m - kmers_.k();
+            std::tie(a, b) = kmers_.find(pattern.data() + i);
+        }
+        uint64_t ret = b - a;
+        for (i--; i < m && ret > 0; i--) {
             c = pattern[i];
-            a = rank(a, c);
-            b = rank(b, c);
-            ret = b - a;
+            // Inside a single run the step is a shift of a and b, or empty.
+            auto r = run_rank_pair(a, b, c);
+            ret = r.second - r.first;
             if (ret == 0) [[unlikely]] {
                 break;
             }
-            a += char_counts_[c];
-            b += char_counts_[c];
+            a = char_counts_[c] + r.first;
+            b = a + ret;
+            if (cache_ && i > 0 && interval_cache::keeps(m - i)) [[unlikely]] {
+                cache_->insert(pattern.data() + i, m - i, a, b);
+            }
+        }
+        if (cache_ && cached < m) {
+            cache_->insert(pattern.data(), m, a, a + ret);
         }
         return ret;
     }
 
+    // Number of symbols in the BWT smaller than c.
+    uint64_t C(uint8_t c) const { return char_counts_[c]; }
+
     uint64_t LF(const uint64_t& i) const {
-        uint8_t c = at(i);
-        return char_counts_[c] + rank(i, c);
+        auto r = inverse_select(i);
+        return char_counts_[r.first] + r.second;
+    }
+
+    // {at(i), rank(i, at(i))} with one block scan.
+    std::pair<uint8_t, uint64_t> inverse_select(uint64_t i) const {
+        if (i >= size_) [[unlikely]] {
+            return {0, rank(i, 0)};
+        }
+        return block_inverse_select(i, b_h_.find(i + 1));
+    }
+
+    // Position of the occurrence of c with rank k, the inverse of rank, or
+    // size() if c occurs at most k times. The block is found by binary search
+    // over the partial sums stored before each block.
+    uint64_t select(uint8_t c, uint64_t k) const {
+        if (k >= char_counts_[uint16_t(c) + 1] - char_counts_[c]) [[unlikely]] {
+            return size_;
+        }
+        c = alpha_.convert(c);
+        uint64_t lo = 0;
+        uint64_t hi = b_h_.size();
+        while (hi - lo > 1) {
+            uint64_t mid = (lo + hi) / 2;
+            const uint8_t* block_data = data_ + b_h_.get(mid).second;
+            if (reinterpret_cast<const alphabet_type*>(block_data - alpha_.size())->p_sum(c, alpha_) <= k) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        auto count = b_h_.get(lo);
+        const uint8_t* block_data = data_ + count.second;
+        k -= reinterpret_cast<const alphabet_type*>(block_data - alpha_.size())->p_sum(c, alpha_);
+        return count.first + reinterpret_cast<const block_type*>(block_data)->select(c, k, alpha_);
     }
 
     uint64_t rank(uint64_t i, uint8_t c) const {
         if (i >= size_) [[unlikely]] {
             return char_counts_[c + 1] - char_counts_[c];
         }
-        c = alphabet_type::convert(c);
         auto count = f_index ? b_h_.find(i, skips[i / f_index]) : b_h_.find(i);
-        i -= count.first;
-        uint64_t res = reinterpret_cast<alphabet_type*>(data_ + count.second - alphabet_type::size())->p_sum(c);
-        res += reinterpret_cast<block_type*>(data_ + count.second)->rank(c, i);
-        return res;
+        return block_rank(i, alpha_.convert(c), count);
+    }
+
+    // Number of symbols smaller than c in BWT[0, i). The block partial sums
+    // of the symbols smaller than c are added up unless build_less_sums has
+    // been called.
+    uint64_t rank_less(uint64_t i, uint8_t c) const {
+        if (i >= size_) [[unlikely]] {
+            return char_counts_[c];
+        }
+        uint32_t less[256];
+        alpha_.less_masks(c, less);
+        // index(i) gives the previous block if i is the first position of a block.
+        uint64_t b = f_index ? b_h_.index(i + 1, skips[i / f_index]) : b_h_.index(i + 1);
+        auto count = b_h_.get(b);
+        const uint8_t* block_data = data_ + count.second;
+        uint64_t res = less_sums_.size()
+                           ? less_sums_[b * (alpha_.sigma() + 1) + alpha_.less_count(c)]
+                           : reinterpret_cast<const alphabet_type*>(block_data - alpha_.size())->p_sum_less(c, alpha_);
+        return res + reinterpret_cast<const block_type*>(block_data)->rank_less(less, i - count.first, alpha_);
+    }
+
+    // {rank(a, c), rank(b, c)} for a <= b.
+    std::pair<uint64_t, uint64_t> rank_pair(uint64_t a, uint64_t b, uint8_t c) const {
+        if (b >= size_) [[unlikely]] {
+            return {rank(a, c), rank(b, c)};
+        }
+        auto count_a = f_index ? b_h_.find(a, skips[a / f_index]) : b_h_.find(a);
+        auto count_b = f_index ? b_h_.find(b, skips[b / f_index]) : b_h_.find(b);
+        c = alpha_.convert(c);
+        if (count_a.second != count_b.second) {
+            return {block_rank(a, c, count_a), block_rank(b, c, count_b)};
+        }
+        return block_rank_pair(a, b, c, count_a);
+    }
+
+    // out[k] = rank(i, symbol(k)) for k < sigma().
+    void rank_all(uint64_t i, uint64_t* out) const {
+        if (i >= size_) [[unlikely]] {
+            for (uint16_t k = 0; k < alpha_.sigma(); k++) {
+                uint8_t c = alpha_.revert(k);
+                out[k] = char_counts_[c + 1] - char_counts_[c];
+            }
+            return;
+        }
+        std::fill_n(out, alpha_.sigma(), 0);
+        // The scan would read past the end of the previous block that find(i)
+        // gives if i is the first position of a block.
+        auto count = f_index ? b_h_.find(i + 1, skips[i / f_index]) : b_h_.find(i + 1);
+        reinterpret_cast<alphabet_type*>(data_ + count.second - alpha_.size())->add_p_sums(out, alpha_);
+        reinterpret_cast<block_type*>(data_ + count.second)->rank_all(i - count.first, out, alpha_);
+    }
+
+    // Distinct symbols of BWT[a, b) for a <= b, in increasing order, with
+    // their ranks at both ends: syms[j] occurs in [a, b), ra[j] = rank(a,
+    // syms[j]) and rb[j] = rank(b, syms[j]) for j less than the returned
+    // count. The arrays need room for sigma() entries. If a and b are in the
+    // same block it is scanned once, otherwise the blocks in between are
+    // skipped with partial sums.
+    uint16_t interval_symbols(uint64_t a, uint64_t b, uint8_t* syms, uint64_t* ra,
+                              uint64_t* rb) const {
+        if (a >= b) [[unlikely]] {
+            return 0;
+        }
+        uint64_t all_a[256];
+        uint64_t all_b[256];
+        if (b >= size_) [[unlikely]] {
+            rank_all(a, all_a);
+            rank_all(b, all_b);
+            return symbols_between(all_a, all_b, syms, ra, rb);
+        }
+        auto count_a = f_index ? b_h_.find(a + 1, skips[a / f_index]) : b_h_.find(a + 1);
+        auto count_b = f_index ? b_h_.find(b + 1, skips[b / f_index]) : b_h_.find(b + 1);
+        if (count_a.second != count_b.second) {
+            rank_all(a, all_a);
+            rank_all(b, all_b);
+            return symbols_between(all_a, all_b, syms, ra, rb);
+        }
+        std::fill_n(all_a, alpha_.sigma(), 0);
+        std::fill_n(all_b, alpha_.sigma(), 0);
+        const uint8_t* block_data = data_ + count_a.second;
+        const alphabet_type* alpha = reinterpret_cast<const alphabet_type*>(block_data - alpha_.size());
+        alpha->add_p_sums(all_a, alpha_);
+        alpha->add_p_sums(all_b, alpha_);
+        reinterpret_cast<const block_type*>(block_data)
+            ->rank_all_pair(a - count_a.first, b - count_a.first, all_a, all_b, alpha_);
+        return symbols_between(all_a, all_b, syms, ra, rb);
+    }
+
+    // out[k] = rank(pos[k], syms[k]) for k < n.
+    //
+    // Queries are run in groups of RANK_GROUP. The heap is descended one level
+    // at a time for the whole group, and the partial sums and blocks of the
+    // group are prefetched before any of them are read, so the cache misses of
+    // independent queries overlap.
+    void rank_batch(const uint64_t* pos, const uint8_t* syms, uint64_t* out, size_t n) const {
+        if constexpr (f_index) {
+            for (size_t k = 0; k < n; k++) {
+                out[k] = rank(pos[k], syms[k]);
+            }
+            return;
+        }
+        uint64_t q[RANK_GROUP];
+        std::pair<uint64_t, uint64_t> counts[RANK_GROUP];
+        for (size_t g = 0; g < n; g += RANK_GROUP) {
+            size_t e = g + RANK_GROUP < n ? g + RANK_GROUP : n;
+            for (size_t k = g; k < e; k++) {
+                q[k - g] = pos[k] < size_ ? pos[k] : 0;
+            }
+            b_h_.template find_batch<RANK_GROUP>(q, counts, e - g);
+            for (size_t k = 0; k < e - g; k++) {
+                const uint8_t* block_data = data_ + counts[k].second;
+                __builtin_prefetch(block_data - alpha_.size());
+                __builtin_prefetch(block_data);
+                __builtin_prefetch(block_data + 64);
+            }
+            for (size_t k = g; k < e; k++) {
+                uint8_t c = syms[k];
+                if (pos[k] >= size_) [[unlikely]] {
+                    out[k] = char_counts_[c + 1] - char_counts_[c];
+                } else {
+                    out[k] = block_rank(pos[k], alpha_.convert(c), counts[k - g]);
+                }
+            }
+        }
+    }
+
+    // out[k] = rank_pair(a[k], b[k], syms[k]) for k < n, with the ends of
+    // RANK_GROUP / 2 pairs at a time ranked together with rank_batch.
+    void rank_pair_batch(const uint64_t* a, const uint64_t* b, const uint8_t* syms,
+                         std::pair<uint64_t, uint64_t>* out, size_t n) const {
+        constexpr size_t group = RANK_GROUP / 2 ? RANK_GROUP / 2 : 1;
+        uint64_t pos[2 * group];
+        uint8_t s[2 * group];
+        uint64_t r[2 * group];
+        for (size_t g = 0; g < n; g += group) {
+            size_t e = g + group < n ? g + group : n;
+            for (size_t k = g; k < e; k++) {
+                pos[2 * (k - g)] = a[k];
+                pos[2 * (k - g) + 1] = b[k];
+                s[2 * (k - g)] = syms[k];
+                s[2 * (k - g) + 1] = syms[k];
+            }
+            rank_batch(pos, s, r, 2 * (e - g));
+            for (size_t k = g; k < e; k++) {
+                out[k] = {r[2 * (k - g)], r[2 * (k - g) + 1]};
+            }
+        }
+    }
+
+    // rows[k] = LF(rows[k]) for k < n, with the symbol at the old row written
+    // to syms[k]. The heap is descended for groups of RANK_GROUP rows together
+    // like in rank_batch.
+    void LF_batch(uint64_t* rows, uint8_t* syms, size_t n) const {
+        uint64_t q[RANK_GROUP];
+        std::pair<uint64_t, uint64_t> counts[RANK_GROUP];
+        for (size_t g = 0; g < n; g += RANK_GROUP) {
+            size_t e = g + RANK_GROUP < n ? g + RANK_GROUP : n;
+            for (size_t k = g; k < e; k++) {
+                q[k - g] = rows[k] < size_ ? rows[k] + 1 : 1;
+            }
+            b_h_.template find_batch<RANK_GROUP>(q, counts, e - g);
+            for (size_t k = 0; k < e - g; k++) {
+                const uint8_t* block_data = data_ + counts[k].second;
+                __builtin_prefetch(block_data - alpha_.size());
+                __builtin_prefetch(block_data);
+                __builtin_prefetch(block_data + 64);
+            }
+            for (size_t k = g; k < e; k++) {
+                auto r = rows[k] < size_ ? block_inverse_select(rows[k], counts[k - g])
+                                         : inverse_select(rows[k]);
+                syms[k] = r.first;
+                rows[k] = char_counts_[r.first] + r.second;
+            }
+        }
+    }
+
+    // out[k] = count(patterns[k]) for k < n.
+    //
+    // Up to COUNT_WINDOW backward searches are kept in flight. Each round
+    // descends the heap for both ends of every active search together, then
+    // prefetches the blocks before any of the steps are taken. Searches that
+    // finish or reach an empty range are replaced by the next pattern.
+    void count_many(const std::string* patterns, uint64_t* out, size_t n) const {
+        if constexpr (f_index) {
+            for (size_t k = 0; k < n; k++) {
+                out[k] = patterns[k].size() ? count(patterns[k]) : size_;
+            }
+            return;
+        }
+        search w[COUNT_WINDOW];
+        uint64_t q[2 * COUNT_WINDOW];
+        std::pair<uint64_t, uint64_t> counts[2 * COUNT_WINDOW];
+        size_t active = 0;
+        size_t next = 0;
+        while (true) {
+            while (active < COUNT_WINDOW && next < n) {
+                if (start_search(patterns, next, out, w[active])) {
+                    active++;
+                }
+                next++;
+            }
+            if (active == 0) {
+                break;
+            }
+            for (size_t k = 0; k < active; k++) {
+                q[2 * k] = w[k].a < size_ ? w[k].a : 0;
+                q[2 * k + 1] = w[k].b < size_ ? w[k].b : 0;
+            }
+            b_h_.template find_batch<2 * COUNT_WINDOW>(q, counts, 2 * active);
+            for (size_t k = 0; k < 2 * active; k++) {
+                const uint8_t* block_data = data_ + counts[k].second;
+                __builtin_prefetch(block_data - alpha_.size());
+                __builtin_prefetch(block_data);
+                __builtin_prefetch(block_data + 64);
+            }
+            // Retiring a search moves the last one to its slot, so the heap
+            // results are looked up through the original slot.
+            size_t slot[COUNT_WINDOW];
+            for (size_t k = 0; k < active; k++) {
+                slot[k] = k;
+            }
+            for (size_t k = 0; k < active;) {
+                search& s = w[k];
+                uint8_t c = patterns[s.p][s.i];
+                const auto& count_a = counts[2 * slot[k]];
+                const auto& count_b = counts[2 * slot[k] + 1];
+                if (s.b < size_ && count_a.second == count_b.second) {
+                    std::tie(s.a, s.b) = block_rank_pair(s.a, s.b, alpha_.convert(c), count_a);
+                    s.a += char_counts_[c];
+                    s.b += char_counts_[c];
+                } else {
+                    s.a = step(s.a, c, count_a);
+                    s.b = step(s.b, c, count_b);
+                }
+                if (s.a == s.b || s.i == 0) {
+                    out[s.p] = s.b - s.a;
+                    active--;
+                    s = w[active];
+                    slot[k] = slot[active];
+                } else {
+                    s.i--;
+                    k++;
+                }
+            }
+        }
     }
 
     uint8_t operator[](size_t i) const {
@@ -284,7 +617,261 @@ class run_rlbwt {
 
     uint64_t size() const { return size_; }
     uint64_t bytes() const { return bytes_; }
+    // Number of distinct symbols, and the symbol with index k < sigma() in
+    // rank_all results. Symbols are ordered by increasing frequency.
+    uint16_t sigma() const { return alpha_.sigma(); }
+    uint8_t symbol(uint16_t k) const { return alpha_.revert(k); }
+
+    // Replaces the k-mer table of the index with one for k-mers, so that count
+    // starts at step k. k = 0 drops the table.
+    void build_kmers(uint16_t k) {
+        bytes_ -= kmers_.bytes();
+        kmers_ = k ? kmer_table::build(*this, k) : kmer_table();
+        bytes_ += kmers_.bytes();
+    }
+
+    const kmer_table& kmers() const { return kmers_; }
+
+    // Stores the block partial sums in symbol order, so that rank_less reads
+    // one value per block instead of adding up the partial sums of the
+    // symbols smaller than c. Takes 8 * (sigma() + 1) bytes per block.
+    void build_less_sums() {
+        uint64_t row = alpha_.sigma() + 1;
+        bytes_ -= less_sums_.size() * sizeof(uint64_t);
+        less_sums_.resize(b_h_.size() * row);
+        for (uint64_t b = 0; b < b_h_.size(); b++) {
+            const uint8_t* block_data = data_ + b_h_.get(b).second;
+            reinterpret_cast<const alphabet_type*>(block_data - alpha_.size())
+                ->less_sums(less_sums_.data() + b * row, alpha_);
+        }
+        bytes_ += less_sums_.size() * sizeof(uint64_t);
+    }
+
+    // Makes count look up and store suffix ranges in cache, or stop using a
+    // cache if cache is null. The cache may be shared by threads querying this
+    // index, but not with other indexes.
+    void set_cache(interval_cache* cache) { cache_ = cache; }
+    page_backing backing() const { return arena_.backing(); }
    private:
+    void load_container(const std::string& path) {
+        container c(path, kind, block_type::encoding, block_type::cap);
+        size_ = c.elems();
+        block_count_ = c.blocks();
+        std::fstream in_file;
+        in_file.open(path, std::ios::binary | std::ios::in);
+        c.seek(in_file, section::statics);
+        bytes_ += alpha_.load_statics(in_file);
+        bytes_ += block_type::load_statics(in_file);
+        c.seek(in_file, section::char_counts);
+        in_file.read(reinterpret_cast<char*>(char_counts_), sizeof(uint64_t) * 257);
+        const section_entry& heap = c.get(section::heap);
+        const section_entry& blocks = c.get(section::block_data);
+        bytes_ += blocks.size;
+        if (mode_ == load_mode::mmap) {
+            in_file.close();
+            data_map_ = mapped_file(path, block_type::padding_bytes, MADV_RANDOM);
+            data_map_.advise(heap.offset, heap.size, MADV_WILLNEED);
+            bytes_ += sizeof(b_heap<>) + b_h_.wrap(data_map_.data() + heap.offset);
+            data_ = data_map_.data() + blocks.offset;
+            return;
+        }
+        c.seek(in_file, section::heap);
+        if (mode_ == load_mode::parallel || mode_ == load_mode::huge) {
+            arena_ = arena(heap.size + blocks.size + block_type::padding_bytes + 128,
+                           mode_ == load_mode::huge);
+            bytes_ += b_h_.load(in_file, [&](uint64_t n) { return arena_.alloc(n); });
+            in_file.close();
+            data_ = arena_.alloc(blocks.size + block_type::padding_bytes);
+            parallel_reader(path).read(data_, blocks.offset, blocks.size);
+            return;
+        }
+        bytes_ += b_h_.load(in_file);
+        data_ = (uint8_t*)std::malloc(blocks.size);
+        c.seek(in_file, section::block_data);
+        in_file.read(reinterpret_cast<char*>(data_), blocks.size);
+        in_file.close();
+    }
+
+    // Two file format with root and "_data" file, from before containers.
+    void load_legacy(const std::string& path) {
+        std::fstream in_file;
+        in_file.open(path, std::ios::binary | std::ios::in);
+        if (in_file.fail()) {
+            std::cerr << "Opening " << path << " failed!" << std::endl;
+            exit(1);
+        }
+        bytes_ += alpha_.load_statics(in_file);
+        bytes_ += block_type::load_statics(in_file);
+        uint64_t data_bytes;
+        in_file.read(reinterpret_cast<char*>(&data_bytes), sizeof(uint64_t));
+        in_file.read(reinterpret_cast<char*>(&size_), sizeof(uint64_t));
+
+        if (mode_ == load_mode::mmap) {
+            uint64_t heap_offset = in_file.tellg();
+            root_map_ = mapped_file(path);
+            uint64_t heap_bytes = b_h_.wrap(root_map_.data() + heap_offset);
+            root_map_.advise(heap_offset, heap_bytes, MADV_WILLNEED);
+            in_file.seekg(heap_offset + heap_bytes);
+            bytes_ += sizeof(b_heap<>) + heap_bytes;
+        } else if (mode_ == load_mode::parallel || mode_ == load_mode::huge) {
+            // The root file size bounds the heap size.
+            arena_ = arena(parallel_reader(path).size() + data_bytes + block_type::padding_bytes + 128,
+                           mode_ == load_mode::huge);
+            bytes_ += b_h_.load(in_file, [&](uint64_t n) { return arena_.alloc(n); });
+        } else {
+            bytes_ += b_h_.load(in_file);
+        }
+
+        in_file.read(reinterpret_cast<char*>(char_counts_), sizeof(uint64_t) * 257);
+        in_file.close();
+
+        std::string prefix;
+        std::string suffix;
+        size_t loc = path.find_last_of('.');
+        if (loc == std::string::npos) {
+            prefix = path;
+            suffix = "";
+        } else {
+            prefix = path.substr(0, loc);
+            suffix = path.substr(loc);
+        }
+        if (mode_ == load_mode::mmap) {
+            data_map_ = mapped_file(prefix + "_data" + suffix,
+                                    block_type::padding_bytes, MADV_RANDOM);
+            data_ = data_map_.data();
+        } else if (mode_ == load_mode::parallel || mode_ == load_mode::huge) {
+            data_ = arena_.alloc(data_bytes + block_type::padding_bytes);
+            parallel_reader(prefix + "_data" + suffix).read(data_, 0, data_bytes);
+        } else {
+            in_file.open(prefix + "_data" + suffix, std::ios::binary | std::ios::in);
+            if (in_file.fail()) {
+                std::cerr << "opening " << prefix << "_data" << suffix << " failed!" << std::endl;
+                exit(1);
+            }
+            data_ = (uint8_t*)std::malloc(data_bytes);
+            in_file.read(reinterpret_cast<char*>(data_), data_bytes);
+            in_file.close();
+        }
+        bytes_ += data_bytes;
+    }
+
+    // Compacts rank_all results at both ends of an interval to the symbols
+    // occurring in it, in increasing order of symbol.
+    uint16_t symbols_between(const uint64_t* all_a, const uint64_t* all_b, uint8_t* syms,
+                             uint64_t* ra, uint64_t* rb) const {
+        uint16_t n = 0;
+        for (uint16_t k = 0; k < alpha_.sigma(); k++) {
+            if (all_a[k] == all_b[k]) {
+                continue;
+            }
+            uint8_t c = alpha_.revert(k);
+            uint16_t j = n++;
+            for (; j > 0 && syms[j - 1] > c; j--) {
+                syms[j] = syms[j - 1];
+                ra[j] = ra[j - 1];
+                rb[j] = rb[j - 1];
+            }
+            syms[j] = c;
+            ra[j] = all_a[k];
+            rb[j] = all_b[k];
+        }
+        return n;
+    }
+
+    // State of a backward search in count_many. [a, b) is the range matching
+    // the suffix of pattern p after position i.
+    struct search {
+        size_t p;
+        size_t i;
+        uint64_t a;
+        uint64_t b;
+    };
+
+    // Starts the search for pattern p. Returns false if the search is done after
+    // the first symbol, with the result written to out.
+    bool start_search(const std::string* patterns, size_t p, uint64_t* out, search& s) const {
+        const std::string& pattern = patterns[p];
+        if (pattern.size() == 0) [[unlikely]] {
+            out[p] = size_;
+            return false;
+        }
+        uint8_t c = pattern[pattern.size() - 1];
+        s = {p, pattern.size() - 1, char_counts_[c], char_counts_[uint16_t(c) + 1]};
+        if (kmers_.covers(pattern.size())) {
+            s.i = pattern.size() - kmers_.k();
+            std::tie(s.a, s.b) = kmers_.find(pattern.data() + s.i);
+        }
+        if (s.a == s.b || s.i == 0) {
+            out[p] = s.b - s.a;
+            return false;
+        }
+        s.i--;
+        return true;
+    }
+
+    // LF step of i with c, with the block of i found by the heap.
+    uint64_t step(uint64_t i, uint8_t c, const std::pair<uint64_t, uint64_t>& count) const {
+        if (i >= size_) [[unlikely]] {
+            return char_counts_[c + 1];
+        }
+        return char_counts_[c] + block_rank(i, alpha_.convert(c), count);
+    }
+
+    // Rank of converted symbol c at i, with the block of i found by the heap.
+    uint64_t block_rank(uint64_t i, uint8_t c, const std::pair<uint64_t, uint64_t>& count) const {
+        i -= count.first;
+        uint64_t res = reinterpret_cast<alphabet_type*>(data_ + count.second - alpha_.size())->p_sum(c, alpha_);
+        res += reinterpret_cast<block_type*>(data_ + count.second)->rank(c, i, alpha_);
+        return res;
+    }
+
+    // inverse_select of i, with the block of i found by the heap.
+    std::pair<uint8_t, uint64_t> block_inverse_select(uint64_t i, const std::pair<uint64_t, uint64_t>& count) const {
+        const uint8_t* block_data = data_ + count.second;
+        auto r = reinterpret_cast<const block_type*>(block_data)->inverse_select(i - count.first, alpha_);
+        uint64_t res = reinterpret_cast<const alphabet_type*>(block_data - alpha_.size())->p_sum(r.first, alpha_);
+        return {alpha_.revert(r.first), res + r.second};
+    }
+
+    // rank_pair(a, b, c) for a < b in count. If [a, b) is short and lies
+    // inside one run of the block of a, the heap is not searched for b, and
+    // empty ranges are returned without reading partial sums.
+    std::pair<uint64_t, uint64_t> run_rank_pair(uint64_t a, uint64_t b, uint8_t c) const {
+        // find(a) gives the previous block if a is the first position of a
+        // block, and the scan needs the block that contains a.
+        auto count_a = f_index ? b_h_.find(a + 1, skips[a / f_index]) : b_h_.find(a + 1);
+        c = alpha_.convert(c);
+        if (b - a <= RUN_SHORTCUT) {
+            auto r = reinterpret_cast<block_type*>(data_ + count_a.second)
+                         ->run_rank(c, a - count_a.first, b - count_a.first, alpha_);
+            if (r) {
+                if (r->first == r->second) {
+                    return {0, 0};
+                }
+                uint64_t res = reinterpret_cast<alphabet_type*>(data_ + count_a.second - alpha_.size())->p_sum(c, alpha_);
+                return {res + r->first, res + r->second};
+            }
+        }
+        if (b >= size_) [[unlikely]] {
+            uint8_t rc = alpha_.revert(c);
+            return {block_rank(a, c, count_a), char_counts_[rc + 1] - char_counts_[rc]};
+        }
+        auto count_b = f_index ? b_h_.find(b, skips[b / f_index]) : b_h_.find(b);
+        if (count_a.second != count_b.second) {
+            return {block_rank(a, c, count_a), block_rank(b, c, count_b)};
+        }
+        return block_rank_pair(a, b, c, count_a);
+    }
+
+    // Ranks of converted symbol c at a <= b, both in the block found for a.
+    std::pair<uint64_t, uint64_t> block_rank_pair(uint64_t a, uint64_t b, uint8_t c,
+                                                  const std::pair<uint64_t, uint64_t>& count) const {
+        uint64_t res = reinterpret_cast<alphabet_type*>(data_ + count.second - alpha_.size())->p_sum(c, alpha_);
+        auto r = reinterpret_cast<block_type*>(data_ + count.second)
+                     ->rank_pair(c, a - count.first, b - count.first, alpha_);
+        return {res + r.first, res + r.second};
+    }
+
     void build_f_index() {
         for (uint64_t i = 0; i < size_; i += f_index) {
             skips.push_back(b_h_.short_cut(i, i + f_index));
@@ -5,6 +5,8 @@
 #include <string>
 #include <bitset>
 #include <cstdint>
+#include <optional>
+#include <utility>
 
 namespace bbwt {
 template <class block_type_>
@@ -12,6 +14,7 @@ class super_block {
    public:
     typedef block_type_ block_type;
     typedef typename block_type::alphabet_type alphabet_type;
+    typedef typename block_type::meta_type meta_type;
     static_assert((uint64_t(1) << 32) % block_type::cap == 0);
     static const constexpr uint64_t blocks =
         (uint64_t(1) << 32) / block_type::cap;
@@ -27,28 +30,160 @@ class super_block {
     super_block& operator=(const super_block& other) = delete;
     super_block& operator=(super_block&& other) = delete;
 
-    uint8_t at(uint32_t i) const {
+    uint8_t at(uint32_t i, const meta_type& m) const {
         uint32_t block_i = i / cap;
         //std::cerr << " block " << block_i << std::endl;
         const block_type* block =
             reinterpret_cast<const block_type*>(data() + offsets_[block_i]);
-        return block->at(i % cap);
+        return block->at(i % cap, m);
     }
 
-    uint32_t rank(uint8_t c, uint32_t i) const {
+    uint32_t rank(uint8_t c, uint32_t i, const meta_type& m) const {
         uint32_t block_i = i / cap;
         //std::cerr << "rank(" << int(c) << ", " << i << ")" << std::endl;
-        __builtin_prefetch(data() + offsets_[block_i]);
-        const alphabet_type* alpha = reinterpret_cast<const alphabet_type*>(
-            data() + offsets_[block_i] - alphabet_type::size());
-        uint32_t res = alpha->p_sum(c);
+        const uint8_t* block_data = data() + offsets_[block_i];
+        __builtin_prefetch(block_data);
+        const alphabet_type* alpha =
+            reinterpret_cast<const alphabet_type*>(block_data - m.size());
+        uint32_t res = alpha->p_sum(c, m);
         //std::cerr << res << " from previous blocks " << std::endl;
-        const block_type* block =
-            reinterpret_cast<const block_type*>(data() + offsets_[block_i]);
-        res += block->rank(c, i % cap);
+        const block_type* block = reinterpret_cast<const block_type*>(block_data);
+        res += block->rank(c, i % cap, m);
         return res;
     }
 
+    // Number of symbols before i that are smaller than c, not converted. less
+    // are the masks of meta_type::less_masks for c. sums, if not null, are
+    // the less_sums of the blocks of this super block, sigma() + 1 per block.
+    uint32_t rank_less(uint8_t c, uint32_t i, const uint32_t* less, const uint32_t* sums,
+                       const meta_type& m) const {
+        uint32_t block_i = i / cap;
+        const uint8_t* block_data = data() + offsets_[block_i];
+        __builtin_prefetch(block_data);
+        uint32_t res = sums ? sums[block_i * (m.sigma() + 1) + m.less_count(c)]
+                            : reinterpret_cast<const alphabet_type*>(block_data - m.size())->p_sum_less(c, m);
+        return res + reinterpret_cast<const block_type*>(block_data)->rank_less(less, i % cap, m);
+    }
+
+    // Writes the less_sums of the partial sums of block block_i to out.
+    void less_sums(uint32_t block_i, uint32_t* out, const meta_type& m) const {
+        const uint8_t* block_data = data() + offsets_[block_i];
+        reinterpret_cast<const alphabet_type*>(block_data - m.size())->less_sums(out, m);
+    }
+
+    // {rank(c, a, m), rank(c, b, m)} for a <= b. Partial sums and the scan are
+    // shared if both are in the same block.
+    std::pair<uint32_t, uint32_t> rank_pair(uint8_t c, uint32_t a, uint32_t b,
+                                            const meta_type& m) const {
+        uint32_t block_i = a / cap;
+        if (b / cap != block_i) {
+            return {rank(c, a, m), rank(c, b, m)};
+        }
+        const uint8_t* block_data = data() + offsets_[block_i];
+        __builtin_prefetch(block_data);
+        const alphabet_type* alpha =
+            reinterpret_cast<const alphabet_type*>(block_data - m.size());
+        uint32_t res = alpha->p_sum(c, m);
+        const block_type* block = reinterpret_cast<const block_type*>(block_data);
+        auto r = block->rank_pair(c, a % cap, b % cap, m);
+        return {res + r.first, res + r.second};
+    }
+
+    // rank_pair for a < b if [a, b) lies inside the block of a. Runs do not
+    // cross blocks, so the block scan stops at a if the run of a covers b.
+    // Partial sums are only read if the range is not empty.
+    std::optional<std::pair<uint32_t, uint32_t>> run_rank(uint8_t c, uint32_t a, uint64_t b,
+                                                          const meta_type& m) const {
+        if ((b - 1) / cap != a / cap) {
+            return std::nullopt;
+        }
+        const uint8_t* block_data = data() + offsets_[a / cap];
+        const block_type* block = reinterpret_cast<const block_type*>(block_data);
+        std::optional<std::pair<uint32_t, uint32_t>> r;
+        if (b / cap == a / cap) {
+            r = block->rank_pair(c, a % cap, b % cap, m);
+        } else {
+            // b is the end of the block.
+            r = block->run_rank(c, a % cap, cap, m);
+        }
+        if (r && r->first != r->second) {
+            uint32_t res = reinterpret_cast<const alphabet_type*>(block_data - m.size())->p_sum(c, m);
+            r->first += res;
+            r->second += res;
+        }
+        return r;
+    }
+
+    // {at(i, m), rank(at(i, m), i, m)} with one block scan.
+    std::pair<uint8_t, uint32_t> inverse_select(uint32_t i, const meta_type& m) const {
+        const uint8_t* block_data = data() + offsets_[i / cap];
+        auto r = reinterpret_cast<const block_type*>(block_data)->inverse_select(i % cap, m);
+        r.second += reinterpret_cast<const alphabet_type*>(block_data - m.size())->p_sum(r.first, m);
+        return r;
+    }
+
+    // Position of the occurrence of c with rank k in the first n blocks, the
+    // inverse of rank. The block is found by binary search over the block
+    // partial sums. touch(j) is called before block j or its partial sums are
+    // read, for paging.
+    template <class F>
+    uint32_t select(uint8_t c, uint32_t k, uint32_t n, const meta_type& m, F touch) const {
+        uint32_t lo = 0;
+        uint32_t hi = n;
+        while (hi - lo > 1) {
+            uint32_t mid = (lo + hi) / 2;
+            touch(mid);
+            const uint8_t* block_data = data() + offsets_[mid];
+            if (reinterpret_cast<const alphabet_type*>(block_data - m.size())->p_sum(c, m) <= k) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        touch(lo);
+        const uint8_t* block_data = data() + offsets_[lo];
+        k -= reinterpret_cast<const alphabet_type*>(block_data - m.size())->p_sum(c, m);
+        return lo * cap + reinterpret_cast<const block_type*>(block_data)->select(c, k, m);
+    }
+
+    // Adds the number of occurrences of each symbol before i to out.
+    void rank_all(uint32_t i, uint64_t* out, const meta_type& m) const {
+        const uint8_t* block_data = data() + offsets_[i / cap];
+        reinterpret_cast<const alphabet_type*>(block_data - m.size())->add_p_sums(out, m);
+        reinterpret_cast<const block_type*>(block_data)->rank_all(i % cap, out, m);
+    }
+
+    // rank_all at a to ra and at b to rb, for a <= b. If both are in the same
+    // block the partial sums are read once and the block is scanned once.
+    // Otherwise the blocks in between are skipped with the partial sums of
+    // the block of b.
+    void rank_all_pair(uint32_t a, uint32_t b, uint64_t* ra, uint64_t* rb,
+                       const meta_type& m) const {
+        if (b / cap != a / cap) {
+            rank_all(a, ra, m);
+            rank_all(b, rb, m);
+            return;
+        }
+        const uint8_t* block_data = data() + offsets_[a / cap];
+        const alphabet_type* alpha = reinterpret_cast<const alphabet_type*>(block_data - m.size());
+        alpha->add_p_sums(ra, m);
+        alpha->add_p_sums(rb, m);
+        reinterpret_cast<const block_type*>(block_data)->rank_all_pair(a % cap, b % cap, ra, rb, m);
+    }
+
+    // Prefetches for rank(., i, m). The block offset has to be in cache before
+    // the block itself can be prefetched.
+    void prefetch_offset(uint32_t i) const {
+        __builtin_prefetch(offsets_ + i / cap);
+    }
+
+    void prefetch_block(uint32_t i, const meta_type& m) const {
+        const uint8_t* block_data = data() + offsets_[i / cap];
+        __builtin_prefetch(block_data - m.size());
+        __builtin_prefetch(block_data);
+        __builtin_prefetch(block_data + 64);
+    }
+
     template <class dtype>
     void print_block(uint32_t idx, uint32_t n_bytes) const {
         dtype* dp = reinterpret_cast<dtype*>(data() + offsets_[idx]);
@@ -57,11 +192,13 @@ class super_block {
         }
     }
 
-    alphabet_type* get_psums(uint32_t i) const {
-        return reinterpret_cast<alphabet_type*>(data() + offsets_[i] - alphabet_type::size());
+    uint64_t block_offset(uint32_t i) const { return offsets_[i]; }
+
+    alphabet_type* get_psums(uint32_t i, const meta_type& m) const {
+        return reinterpret_cast<alphabet_type*>(data() + offsets_[i] - m.size());
     }
 
-    void print(uint64_t s) const {
+    void print(uint64_t s, const meta_type& m) const {
         bool done = false;
         for (uint32_t i = 0; i < blocks; i++) {
             std::cerr << "sub-block " << i << ": " << std::endl;
@@ -73,17 +210,19 @@ class super_block {
             sb = cap;
             uint32_t block_i = (sb - 1) / cap;
             const alphabet_type* alpha = reinterpret_cast<const alphabet_type*>(
-                data() + offsets_[block_i] - alphabet_type::size());
-            alpha->print();
+                data() + offsets_[block_i] - m.size());
+            alpha->print(m);
             const block_type* block =
                 reinterpret_cast<const block_type*>(data() + offsets_[block_i]);
-            block->print(sb);
+            block->print(sb, m);
             if (done) break;
         }
     }
 
-    static uint64_t write_statics(std::fstream&) {return 0; }
-    static uint64_t load_statics(std::fstream&) {return 0; }
+    template <class o_t>
+    static uint64_t write_statics(o_t&) {return 0; }
+    template <class i_t>
+    static uint64_t load_statics(i_t&) {return 0; }
 
    private:
     const uint8_t* data() const {
@@ -1,13 +1,17 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <optional>
 #include <immintrin.h>
+#include <utility>
 
 namespace bbwt {
 template <uint32_t block_size, class alphabet_type_, bool avx = false>
 class two_byte_block {
    public:
     typedef alphabet_type_ alphabet_type;
+    typedef typename alphabet_type::meta_type meta_type;
 
    private:
     static_assert(block_size <= ~uint32_t(0) >> 1);
@@ -21,9 +25,15 @@ class two_byte_block {
    public:
     static const constexpr bool has_members = false;
     static const constexpr uint32_t cap = block_size;
+    static const constexpr uint32_t encoding = 1;
     static const constexpr uint32_t scratch_blocks = 2;
     static const constexpr uint32_t min_size = 2;
-    static const constexpr uint32_t padding_bytes = avx ? 32 : 0;
+    // rank_all reads whole vectors of runs, past the end of the last block.
+#ifdef __AVX2__
+    static const constexpr uint32_t padding_bytes = 32;
+#else
+    static const constexpr uint32_t padding_bytes = 0;
+#endif
 
     static const constexpr uint32_t max_size = 2 * block_size;
     static constexpr uint64_t scratch_size(uint32_t i) {
@@ -41,13 +51,14 @@ class two_byte_block {
     two_byte_block& operator=(two_byte_block&& other) = delete;
     two_byte_block& operator=(const two_byte_block&) = delete;
 
-    uint32_t append(uint8_t head, uint32_t length, uint8_t** scratch) {
-        const uint16_t SHIFT = 16 - alphabet_type::width;
+    uint32_t append(uint8_t head, uint32_t length, uint8_t** scratch,
+                    const meta_type& m) {
+        const uint16_t SHIFT = 16 - m.width;
         const uint16_t LIMIT = uint16_t(1) << SHIFT;
         const uint16_t MASK = LIMIT - 1;
         uint64_t* offset = reinterpret_cast<uint64_t*>(scratch[0]);
         uint16_t* data = reinterpret_cast<uint16_t*>(scratch[1]);
-        if constexpr (LIMIT < cap) {
+        if (LIMIT < cap) {
             while (length > LIMIT) {
                 data[offset[0]++] = (head << SHIFT) | MASK;
                 length -= LIMIT;
@@ -57,14 +68,14 @@ class two_byte_block {
         return offset[0] * 2;
     }
 
-    uint8_t at(uint32_t location) const {
+    uint8_t at(uint32_t location, const meta_type& m) const {
 #ifdef __AVX2__
         if constexpr (avx) {
-            avx_at(location);
+            avx_at(location, m);
         }
 #endif
         const uint16_t* data = reinterpret_cast<const uint16_t*>(this);
-        const uint16_t SHIFT = 16 - alphabet_type::width;
+        const uint16_t SHIFT = 16 - m.width;
         const uint16_t LIMIT = uint16_t(1) << SHIFT;
         const uint16_t MASK = LIMIT - 1;
         uint32_t i = 0;
@@ -78,15 +89,15 @@ class two_byte_block {
         }
     }
 
-    uint32_t rank(uint8_t c, uint32_t location) const {
+    uint32_t rank(uint8_t c, uint32_t location, const meta_type& m) const {
 #ifdef __AVX2__
         if constexpr (avx) {
-            avx_rank(c, location);
+            avx_rank(c, location, m);
         }
 #endif
         //std::cerr << "rank(" << int(c) << ", " << location << ")" << std::endl;
         const uint16_t* data = reinterpret_cast<const uint16_t*>(this);
-        const uint16_t SHIFT = 16 - alphabet_type::width;
+        const uint16_t SHIFT = 16 - m.width;
         const uint16_t LIMIT = uint16_t(1) << SHIFT;
         const uint16_t MASK = LIMIT - 1;
         uint32_t res = 0;
@@ -107,6 +118,195 @@ class two_byte_block {
         }
     }
 
+    // Number of symbols before location that are smaller than some symbol.
+    // Run lengths are masked with less, see meta_type::less_masks.
+    uint32_t rank_less(const uint32_t* less, uint32_t location, const meta_type& m) const {
+        const uint16_t* data = reinterpret_cast<const uint16_t*>(this);
+        const uint16_t SHIFT = 16 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        uint32_t res = 0;
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current = data[i] >> SHIFT;
+            uint16_t length = 1 + (data[i++] & MASK);
+            if (location >= length) [[likely]] {
+                location -= length;
+                res += length & less[current];
+            } else {
+                res += location & less[current];
+                return res;
+            }
+        }
+    }
+
+    // {at(location, m), rank(at(location, m), location, m)} with one scan.
+    std::pair<uint8_t, uint32_t> inverse_select(uint32_t location, const meta_type& m) const {
+        const uint16_t* data = reinterpret_cast<const uint16_t*>(this);
+        const uint16_t SHIFT = 16 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        uint32_t counts[256];
+        std::fill_n(counts, uint16_t(1) << m.width, 0);
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current = data[i] >> SHIFT;
+            uint16_t length = 1 + (data[i++] & MASK);
+            if (location >= length) [[likely]] {
+                location -= length;
+                counts[current] += length;
+            } else {
+                return {current, counts[current] + location};
+            }
+        }
+    }
+
+    // Adds the number of occurrences of each symbol before location to out.
+    void rank_all(uint32_t location, uint64_t* out, const meta_type& m) const {
+#ifdef __AVX2__
+        if (m.width >= 2 && m.width <= 3) {
+            avx_rank_all(location, out, m);
+            return;
+        }
+#endif
+        const uint16_t* data = reinterpret_cast<const uint16_t*>(this);
+        const uint16_t SHIFT = 16 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current = data[i] >> SHIFT;
+            uint16_t length = 1 + (data[i++] & MASK);
+            if (location >= length) [[likely]] {
+                location -= length;
+                out[current] += length;
+            } else {
+                out[current] += location;
+                return;
+            }
+        }
+    }
+
+    // Adds the number of occurrences of each symbol before a to ra and before
+    // b to rb, for a <= b, with one scan.
+    void rank_all_pair(uint32_t a, uint32_t b, uint64_t* ra, uint64_t* rb,
+                       const meta_type& m) const {
+#ifdef __AVX2__
+        if (m.width >= 2 && m.width <= 3) {
+            avx_rank_all_pair(a, b, ra, rb, m);
+            return;
+        }
+#endif
+        const uint16_t* data = reinterpret_cast<const uint16_t*>(this);
+        const uint16_t SHIFT = 16 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        uint32_t i = 0;
+        uint8_t current;
+        uint16_t length;
+        while (true) {
+            current = data[i] >> SHIFT;
+            length = 1 + (data[i++] & MASK);
+            if (a >= length) [[likely]] {
+                a -= length;
+                b -= length;
+                ra[current] += length;
+                rb[current] += length;
+            } else {
+                break;
+            }
+        }
+        ra[current] += a;
+        while (b >= length) {
+            b -= length;
+            rb[current] += length;
+            current = data[i] >> SHIFT;
+            length = 1 + (data[i++] & MASK);
+        }
+        rb[current] += b;
+    }
+
+    // {rank(c, a, m), rank(c, b, m)} with a scan to a only, if [a, b) lies
+    // inside one run of the block. Otherwise b may be past the end of the block.
+    std::optional<std::pair<uint32_t, uint32_t>> run_rank(uint8_t c, uint32_t a, uint32_t b,
+                                                          const meta_type& m) const {
+        const uint16_t* data = reinterpret_cast<const uint16_t*>(this);
+        const uint16_t SHIFT = 16 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        uint32_t res = 0;
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current = data[i] >> SHIFT;
+            uint16_t length = 1 + (data[i++] & MASK);
+            if (a >= length) [[likely]] {
+                a -= length;
+                b -= length;
+                res += current == c ? length : 0;
+            } else if (b > length) {
+                return std::nullopt;
+            } else if (current == c) {
+                return std::pair<uint32_t, uint32_t>(res + a, res + b);
+            } else {
+                return std::pair<uint32_t, uint32_t>(res, res);
+            }
+        }
+    }
+
+    // {rank(c, a, m), rank(c, b, m)} for a <= b, with one scan.
+    std::pair<uint32_t, uint32_t> rank_pair(uint8_t c, uint32_t a, uint32_t b,
+                                            const meta_type& m) const {
+        const uint16_t* data = reinterpret_cast<const uint16_t*>(this);
+        const uint16_t SHIFT = 16 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        uint32_t res = 0;
+        uint32_t i = 0;
+        uint8_t current;
+        uint16_t length;
+        while (true) {
+            current = data[i] >> SHIFT;
+            length = 1 + (data[i++] & MASK);
+            if (a >= length) [[likely]] {
+                a -= length;
+                b -= length;
+                res += current == c ? length : 0;
+            } else {
+                break;
+            }
+        }
+        uint32_t res_a = res + (current == c ? a : 0);
+        while (b >= length) {
+            b -= length;
+            res += current == c ? length : 0;
+            current = data[i] >> SHIFT;
+            length = 1 + (data[i++] & MASK);
+        }
+        return {res_a, res + (current == c ? b : 0)};
+    }
+
+    // Position of the occurrence of c with rank k, the inverse of rank. The
+    // block has to contain more than k occurrences of c.
+    uint32_t select(uint8_t c, uint32_t k, const meta_type& m) const {
+        const uint16_t SHIFT = 16 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        const uint16_t* data = reinterpret_cast<const uint16_t*>(this);
+        uint32_t location = 0;
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current = data[i] >> SHIFT;
+            uint16_t length = 1 + (data[i++] & MASK);
+            if (current == c) {
+                if (k < length) {
+                    return location + k;
+                }
+                k -= length;
+            }
+            location += length;
+        }
+    }
+
     uint64_t commit(uint8_t** scratch) {
         uint64_t bytes = reinterpret_cast<uint64_t*>(scratch[0])[0];
         bytes *= 2;
@@ -117,12 +317,14 @@ class two_byte_block {
     }
 
     void clear() {}
-    static void write_statics(std::fstream&) {return; }
-    static uint64_t load_statics(std::fstream&) {return 0; }
+    template <class o_t>
+    static void write_statics(o_t&) {return; }
+    template <class i_t>
+    static uint64_t load_statics(i_t&) {return 0; }
 
-    void print(uint32_t sb) const {
+    void print(uint32_t sb, const meta_type& m) const {
         const uint16_t* data = reinterpret_cast<const uint16_t*>(this);
-        const uint16_t SHIFT = 16 - alphabet_type::width;
+        const uint16_t SHIFT = 16 - m.width;
         const uint16_t LIMIT = uint16_t(1) << SHIFT;
         const uint16_t MASK = LIMIT - 1;
         uint32_t i = 0;
@@ -144,14 +346,14 @@ class two_byte_block {
         __m128i high = _mm256_extracti128_si256(a, 1);
         low = _mm_add_epi32(low, high);
 
-        high = _mm_move_epi64(low);
+        high = _mm_unpackhi_epi64(low, low);
         low = _mm_add_epi32(low, high);
-        return _mm_extract_epi32(low, 1) + _mm_extract_epi32(low, 2);
+        return _mm_extract_epi32(low, 0) + _mm_extract_epi32(low, 1);
     }
 
-    uint8_t avx_at(uint32_t location) const {
+    uint8_t avx_at(uint32_t location, const meta_type& m) const {
         const __m256i* vdata = reinterpret_cast<const __m256i*>(this);
-        const uint16_t SHIFT = 16 - alphabet_type::width;
+        const uint16_t SHIFT = 16 - m.width;
         const uint16_t LIMIT = uint16_t(1) << SHIFT;
         const uint16_t MASK = LIMIT - 1;
         const __m256i VMASK = _mm256_set1_epi16(MASK);
@@ -181,13 +383,96 @@ class two_byte_block {
         return 0;
     }
 
-    uint32_t avx_rank(uint8_t c, uint32_t location) const {
+    // rank_all for alphabets of 3 to 8 symbols. Runs are read 16 at a time,
+    // with run lengths summed per symbol in vector registers. The run that
+    // contains location is resolved one run at a time.
+    void avx_rank_all(uint32_t location, uint64_t* out, const meta_type& m) const {
+        __m256i counts[8] = {};
+        uint32_t i = 0;
+        uint32_t length = 0;
+        avx_count_runs(location, counts, i, length, m);
+        avx_add_counts(location, counts, i, length, out, m);
+    }
+
+    // rank_all_pair with one vector pass: the counts of the pass up to a are
+    // added to ra, and the pass continues from there up to b.
+    void avx_rank_all_pair(uint32_t a, uint32_t b, uint64_t* ra, uint64_t* rb,
+                           const meta_type& m) const {
+        __m256i counts[8] = {};
+        uint32_t i = 0;
+        uint32_t length = 0;
+        avx_count_runs(a, counts, i, length, m);
+        avx_add_counts(a, counts, i, length, ra, m);
+        avx_count_runs(b, counts, i, length, m);
+        avx_add_counts(b, counts, i, length, rb, m);
+    }
+
+    // Sums run lengths per symbol to counts for the vectors of runs from
+    // vector i on that end at or before location. length is the number of
+    // symbols before vector i.
+    void avx_count_runs(uint32_t location, __m256i* counts, uint32_t& i, uint32_t& length,
+                        const meta_type& m) const {
+        const __m256i* vdata = reinterpret_cast<const __m256i*>(this);
+        const uint16_t SHIFT = 16 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        const __m256i VMASK = _mm256_set1_epi16(MASK);
+        const uint16_t symbols = uint16_t(1) << m.width;
+        while (true) {
+            __m256i v = _mm256_lddqu_si256(vdata + i);
+            __m256i cvec = _mm256_srli_epi16(v, SHIFT);
+            v = _mm256_and_si256(v, VMASK);
+            v = _mm256_add_epi16(v, ONES);
+            uint32_t v_length = sum32(_mm256_madd_epi16(v, ONES));
+            if (length + v_length > location) [[unlikely]] {
+                return;
+            }
+            length += v_length;
+            i++;
+            for (uint16_t c = 0; c < symbols; c++) {
+                __m256i l = _mm256_and_si256(v, _mm256_cmpeq_epi16(cvec, _mm256_set1_epi16(c)));
+                counts[c] = _mm256_add_epi32(counts[c], _mm256_madd_epi16(l, ONES));
+            }
+        }
+    }
+
+    // Adds counts, and the runs of vector i up to location, to out.
+    void avx_add_counts(uint32_t location, const __m256i* counts, uint32_t i, uint32_t length,
+                        uint64_t* out, const meta_type& m) const {
+        const uint16_t SHIFT = 16 - m.width;
+        const uint16_t LIMIT = uint16_t(1) << SHIFT;
+        const uint16_t MASK = LIMIT - 1;
+        const uint16_t symbols = uint16_t(1) << m.width;
+        for (uint16_t c = 0; c < symbols; c++) {
+            uint32_t res = sum32(counts[c]);
+            // Symbols that are not in the alphabet stay 0.
+            if (res) {
+                out[c] += res;
+            }
+        }
+        const uint16_t* data =
+            reinterpret_cast<const uint16_t*>(reinterpret_cast<const __m256i*>(this) + i);
+        location -= length;
+        for (uint32_t ii = 0; ii < AVX_COUNT; ii++) {
+            uint8_t current = data[ii] >> SHIFT;
+            uint16_t l = 1 + (data[ii] & MASK);
+            if (location >= l) {
+                location -= l;
+                out[current] += l;
+            } else {
+                out[current] += location;
+                return;
+            }
+        }
+    }
+
+    uint32_t avx_rank(uint8_t c, uint32_t location, const meta_type& m) const {
         const __m256i* vdata = reinterpret_cast<const __m256i*>(this);
         const __m256i ccomp = _mm256_set1_epi16(c);
-        const uint16_t SHIFT = 16 - alphabet_type::width;
+        const uint16_t SHIFT = 16 - m.width;
         const uint16_t LIMIT = uint16_t(1) << SHIFT;
         const uint16_t MASK = LIMIT - 1;
-        const __m256i CMASK = _mm256_set1_epi16((uint16_t(1) << alphabet_type::width) - 1);
+        const __m256i CMASK = _mm256_set1_epi16((uint16_t(1) << m.width) - 1);
         const __m256i VMASK = _mm256_set1_epi16(MASK);
         
         uint32_t res = 0;
@@ -5,8 +5,8 @@
 #include "block_rlbwt.hpp"
 //#include "byte_alphabet.hpp"
 #include "byte_block.hpp"
-#include "custom_alphabet.hpp"
 #include "d_block.hpp"
+#include "fmd_index.hpp"
 //#include "delta_alphabet.hpp"
 #include "one_byte_block.hpp"
 #include "super_block.hpp"
@@ -31,33 +31,16 @@
 
 namespace bbwt {
 
-template <uint32_t block_size = SMALL_BLOCK_SIZE>
-using two_byte_build = block_rlbwt<
-    super_block<two_byte_block<block_size, custom_alphabet<uint32_t>>>,
-    custom_alphabet<uint64_t>>;
-
 template <uint32_t block_size = SMALL_BLOCK_SIZE>
 using two_byte = block_rlbwt<
     super_block<two_byte_block<block_size, alphabet<uint32_t>>>,
     alphabet<uint64_t>>;
 
-template <uint32_t block_size = LARGE_BLOCK_SIZE>
-using vbyte_build = block_rlbwt<
-    super_block<byte_block<block_size, custom_alphabet<uint32_t>>>,
-    custom_alphabet<uint64_t>>;
-
 template <uint32_t block_size = LARGE_BLOCK_SIZE>
 using vbyte = block_rlbwt<
     super_block<byte_block<block_size, alphabet<uint32_t>>>,
     alphabet<uint64_t>>;
 
-template <uint32_t block_size = SMALL_BLOCK_SIZE>
-using dyn_build = block_rlbwt<
-    super_block<
-        d_block<two_byte_block<block_size, custom_alphabet<uint32_t>>,
-                two_byte_block<block_size, custom_alphabet<uint32_t>>>>,
-    custom_alphabet<uint64_t>>;
-
 template <uint32_t block_size = SMALL_BLOCK_SIZE>
 using dyn = block_rlbwt<
     super_block<
@@ -65,13 +48,6 @@ using dyn = block_rlbwt<
                 two_byte_block<block_size, alphabet<uint32_t>>>>,
     alphabet<uint64_t>>;
 
-template <uint32_t block_size = SMALL_BLOCK_SIZE>
-using t_dyn_build = block_rlbwt<
-    super_block<
-        d_block<byte_block<block_size, custom_alphabet<uint32_t>>,
-                two_byte_block<block_size, custom_alphabet<uint32_t>>>>,
-    custom_alphabet<uint64_t>>;
-
 template <uint32_t block_size = SMALL_BLOCK_SIZE>
 using t_dyn = block_rlbwt<
     super_block<
@@ -79,10 +55,10 @@ using t_dyn = block_rlbwt<
                 two_byte_block<block_size, alphabet<uint32_t>>>>,
     alphabet<uint64_t>>;
 
-template <uint32_t n_runs = RUN_COUNT>
-using run_build = run_rlbwt<vbyte_runs<n_runs, custom_alphabet<uint64_t>>>;
-
 template <uint32_t n_runs = RUN_COUNT>
 using run = run_rlbwt<vbyte_runs<n_runs, alphabet<uint64_t>>, 0>;
 
+template <uint32_t block_size = SMALL_BLOCK_SIZE>
+using fmd = fmd_index<two_byte<block_size>>;
+
 }  // namespace bbwt
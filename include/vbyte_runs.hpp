@@ -1,14 +1,19 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <optional>
 #include <cstring>
+#include <utility>
 
 namespace bbwt {
 template <uint32_t block_size, class alphabet_type_>
 class vbyte_runs {
    public:
     typedef alphabet_type_ alphabet_type;
+    typedef typename alphabet_type::meta_type meta_type;
     static const constexpr uint32_t cap = block_size;
+    static const constexpr uint32_t encoding = 4;
     static const constexpr uint32_t scratch_blocks = 2;
     static const constexpr uint32_t min_size = block_size;
     static const constexpr uint32_t padding_bytes = 0;
@@ -30,14 +35,15 @@ class vbyte_runs {
     vbyte_runs& operator=(vbyte_runs&& other) = delete;
     vbyte_runs& operator=(const vbyte_runs&) = delete;
 
-    uint32_t append(uint8_t head, uint32_t length, uint8_t** scratch) {
-        const uint8_t SHIFT = 8 - alphabet_type::width;
+    uint32_t append(uint8_t head, uint32_t length, uint8_t** scratch,
+                    const meta_type& m) {
+        const uint8_t SHIFT = 8 - m.width;
         const uint8_t BYTE_MASK = SHIFT > 0 ? (uint8_t(1) << (SHIFT - 1)) - 1 : 0;
         uint64_t* offset = reinterpret_cast<uint64_t*>(scratch[0]);
         uint8_t* data = scratch[1];
         --length;
         data[offset[0]] = head << SHIFT;
-        if (alphabet_type::width < 7) {
+        if (m.width < 7) {
             if (length <= BYTE_MASK) {
                 data[offset[0]++] |= length;
                 return offset[0];
@@ -45,14 +51,14 @@ class vbyte_runs {
                 data[offset[0]++] |= (uint8_t(1) << (SHIFT - 1)) | (length & BYTE_MASK);
                 length >>= SHIFT - 1;
             }
-        } else if (alphabet_type::width == 7) {
+        } else if (m.width == 7) {
             if (length == 0) {
                 offset[0]++;
                 return offset[0];
             } else {
                 data[offset[0]++] |= uint8_t(1) << (SHIFT - 1);
             }
-        } if (alphabet_type::width == 8) {
+        } if (m.width == 8) {
             offset[0]++;
         }
         const constexpr uint8_t mask = 0b01111111;
@@ -65,12 +71,12 @@ class vbyte_runs {
         return offset[0];
     }
 
-    uint8_t at(uint32_t location) const {
+    uint8_t at(uint32_t location, const meta_type& m) const {
         uint32_t i = 0;
         while (true) {
             uint8_t c;
             uint32_t rl;
-            read(i, c, rl);
+            read(i, c, rl, m);
             rl++;
             if (location >= rl) {
                 location -= rl;
@@ -80,14 +86,14 @@ class vbyte_runs {
         }
     }
 
-    uint32_t rank(uint8_t c, uint32_t location) const {
+    uint32_t rank(uint8_t c, uint32_t location, const meta_type& m) const {
         uint32_t res = 0;
         uint32_t i = 0;
         
         while (true) {
             uint8_t current;
             uint32_t rl;
-            read(i, current, rl);
+            read(i, current, rl, m);
             rl++;
             if (location >= rl) [[likely]] {
                 location -= rl;
@@ -99,6 +105,165 @@ class vbyte_runs {
         }
     }
 
+    // Number of symbols before location that are smaller than some symbol.
+    // Run lengths are masked with less, see meta_type::less_masks.
+    uint32_t rank_less(const uint32_t* less, uint32_t location, const meta_type& m) const {
+        uint32_t res = 0;
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current;
+            uint32_t rl;
+            read(i, current, rl, m);
+            rl++;
+            if (location >= rl) [[likely]] {
+                location -= rl;
+                res += rl & less[current];
+            } else {
+                res += location & less[current];
+                return res;
+            }
+        }
+    }
+
+    // {at(location, m), rank(at(location, m), location, m)} with one scan.
+    std::pair<uint8_t, uint32_t> inverse_select(uint32_t location, const meta_type& m) const {
+        uint32_t counts[256];
+        std::fill_n(counts, uint16_t(1) << m.width, 0);
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current;
+            uint32_t rl;
+            read(i, current, rl, m);
+            rl++;
+            if (location >= rl) [[likely]] {
+                location -= rl;
+                counts[current] += rl;
+            } else {
+                return {current, counts[current] + location};
+            }
+        }
+    }
+
+    // Adds the number of occurrences of each symbol before location to out.
+    void rank_all(uint32_t location, uint64_t* out, const meta_type& m) const {
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current;
+            uint32_t rl;
+            read(i, current, rl, m);
+            rl++;
+            if (location >= rl) [[likely]] {
+                location -= rl;
+                out[current] += rl;
+            } else {
+                out[current] += location;
+                return;
+            }
+        }
+    }
+
+    // Adds the number of occurrences of each symbol before a to ra and before
+    // b to rb, for a <= b, with one scan.
+    void rank_all_pair(uint32_t a, uint32_t b, uint64_t* ra, uint64_t* rb,
+                       const meta_type& m) const {
+        uint32_t i = 0;
+        uint8_t current;
+        uint32_t rl;
+        while (true) {
+            read(i, current, rl, m);
+            rl++;
+            if (a >= rl) [[likely]] {
+                a -= rl;
+                b -= rl;
+                ra[current] += rl;
+                rb[current] += rl;
+            } else {
+                break;
+            }
+        }
+        ra[current] += a;
+        while (b >= rl) {
+            b -= rl;
+            rb[current] += rl;
+            read(i, current, rl, m);
+            rl++;
+        }
+        rb[current] += b;
+    }
+
+    // {rank(c, a, m), rank(c, b, m)} with a scan to a only, if [a, b) lies
+    // inside one run of the block. Otherwise b may be past the end of the block.
+    std::optional<std::pair<uint32_t, uint32_t>> run_rank(uint8_t c, uint32_t a, uint32_t b,
+                                                          const meta_type& m) const {
+        uint32_t res = 0;
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current;
+            uint32_t rl;
+            read(i, current, rl, m);
+            rl++;
+            if (a >= rl) [[likely]] {
+                a -= rl;
+                b -= rl;
+                res += current == c ? rl : 0;
+            } else if (b > rl) {
+                return std::nullopt;
+            } else if (current == c) {
+                return std::pair<uint32_t, uint32_t>(res + a, res + b);
+            } else {
+                return std::pair<uint32_t, uint32_t>(res, res);
+            }
+        }
+    }
+
+    // {rank(c, a, m), rank(c, b, m)} for a <= b, with one scan.
+    std::pair<uint32_t, uint32_t> rank_pair(uint8_t c, uint32_t a, uint32_t b,
+                                            const meta_type& m) const {
+        uint32_t res = 0;
+        uint32_t i = 0;
+        uint8_t current;
+        uint32_t rl;
+        while (true) {
+            read(i, current, rl, m);
+            rl++;
+            if (a >= rl) [[likely]] {
+                a -= rl;
+                b -= rl;
+                res += current == c ? rl : 0;
+            } else {
+                break;
+            }
+        }
+        uint32_t res_a = res + (current == c ? a : 0);
+        while (b >= rl) {
+            b -= rl;
+            res += current == c ? rl : 0;
+            read(i, current, rl, m);
+            rl++;
+        }
+        return {res_a, res + (current == c ? b : 0)};
+    }
+
+    // Position of the occurrence of c with rank k, the inverse of rank. The
+    // block has to contain more than k occurrences of c.
+    uint32_t select(uint8_t c, uint32_t k, const meta_type& m) const {
+        uint32_t location = 0;
+        uint32_t i = 0;
+        while (true) {
+            uint8_t current;
+            uint32_t rl;
+            read(i, current, rl, m);
+            rl++;
+            if (current == c) {
+                if (k < rl) {
+                    return location + k;
+                }
+                k -= rl;
+            }
+            location += rl;
+        }
+    }
+
     uint64_t commit(uint8_t** scratch) {
         uint64_t bytes = reinterpret_cast<uint64_t*>(scratch[0])[0];
         uint8_t* data = reinterpret_cast<uint8_t*>(this);
@@ -114,17 +279,19 @@ class vbyte_runs {
     }
 
     void clear() {}
-    static void write_statics(std::fstream&) {return; }
-    static uint64_t load_statics(std::fstream&) {return 0; }
+    template <class o_t>
+    static void write_statics(o_t&) {return; }
+    template <class i_t>
+    static uint64_t load_statics(i_t&) {return 0; }
 
-    void print(uint32_t syms) const {
+    void print(uint32_t syms, const meta_type& m) const {
         uint32_t i = 0;
         while  (true) {
             uint8_t current;
             uint32_t rl;
-            read(i, current, rl);
+            read(i, current, rl, m);
             rl++;
-            std::cerr << " run " << alphabet_type::revert(current) << ", " << rl << std::endl;
+            std::cerr << " run " << m.revert(current) << ", " << rl << std::endl;
             if (rl < syms) {
                 syms -= rl;
             } else {
@@ -134,15 +301,17 @@ class vbyte_runs {
     }
 
    private:
-    inline void read(uint32_t& i, uint8_t& c, uint32_t& rl) const {
-        const uint8_t SHIFT = 8 - alphabet_type::width;
+    // Forced inline, GCC stops inlining this once a few scans use it.
+    __attribute__((always_inline)) inline void read(uint32_t& i, uint8_t& c, uint32_t& rl,
+                                                    const meta_type& m) const {
+        const uint8_t SHIFT = 8 - m.width;
         const uint8_t BYTE_MASK = SHIFT > 0 ? (uint8_t(1) << (SHIFT - 1)) - 1 : 0;
         const uint8_t* data = reinterpret_cast<const uint8_t*>(this);
         uint8_t offset = 0;
-        if (alphabet_type::width == 8) {
+        if (m.width == 8) {
             c = data[i++];
             rl = 0;
-        } else if (alphabet_type::width == 7) {
+        } else if (m.width == 7) {
             c = data[i] >> 1;
             rl = 0;
             if ((data[i++] & 0b00000001) == 0) {
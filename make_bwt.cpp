@@ -1,8 +1,13 @@
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <vector>
 
+#include "include/byte_alphabet.hpp"
 #include "include/debug.hpp"
+#include "include/extract.hpp"
+#include "include/mapped_file.hpp"
 #include "include/reader.hpp"
 #include "include/types.hpp"
 
@@ -16,6 +21,12 @@ void help() {
         << "   -s             Sacrifice speed to pack better.\n"
         << "   -c             Use constant number of runs instead of symbols.\n"
         << "   -q count       Generate binary query sequence to std::cout.\n"
+        << "   -l c           Add locate support. c is the last symbol of the text\n"
+        << "                  and may occur only once.\n"
+        << "   -x step        Add text extraction, sampling the inverse suffix array\n"
+        << "                  every step text positions. Needs -l.\n"
+        << "   -k k           Add a table of the ranges of all k-mers, so that\n"
+        << "                  count starts at step k.\n"
         << "   -n             Strip new line characters from input.\n\n";
     std::cout 
         << "Ouput file is required.\n"
@@ -27,50 +38,37 @@ void help() {
     exit(0);
 }
 
-typedef bbwt::two_byte_build<> bwt_type_a;
-typedef bbwt::vbyte_build<> bwt_type_b;
-typedef bbwt::run_build<> bwt_type_r;
+typedef bbwt::two_byte<> bwt_type_a;
+typedef bbwt::vbyte<> bwt_type_b;
+typedef bbwt::run<> bwt_type_r;
 
-template <class bwt_t>
-void build(char const* argv[], size_t in_file_loc, size_t heads_loc,
-           size_t runs_loc, size_t out_file_loc, bool strip_new_line, 
-           uint32_t n_queries) {
-    typename bwt_t::builder b(argv[out_file_loc]);
-    if (in_file_loc) {
-        std::ifstream in(argv[in_file_loc]);
-        bbwt::file_reader<typename bwt_t::alphabet_type> reader(&in);
-        for (auto it : reader) {
-            if (strip_new_line && (it.head == '\n')) {
-                continue;
-            }
-            b.append(it.head, it.length);
-        }
-    } else if (runs_loc || heads_loc) {
-        if (runs_loc == 0 || heads_loc == 0) {
-            std::cerr << "Both heads and run lengths are required" << std::endl;
-            help();
-        }
-        std::ifstream heads;
-        std::ifstream runs;
-        heads.open(argv[heads_loc], std::ios_base::in | std::ios_base::binary);
-        runs.open(argv[runs_loc], std::ios_base::in | std::ios_base::binary);
-        bbwt::multi_reader<typename bwt_t::alphabet_type> reader(&heads, &runs);
-        for (auto it : reader) {
-            if (strip_new_line && (it.head == '\n')) {
-                continue;
-            }
-            b.append(it.head, it.length);
-        }
-    } else {
-        bbwt::file_reader<typename bwt_t::alphabet_type> reader(&std::cin);
-        for (auto it : reader) {
-            if (strip_new_line && (it.head == '\n')) {
-                continue;
-            }
-            b.append(it.head, it.length);
-        }
+// The input is passed over twice: first to count symbols, from which the
+// alphabet and partial sum layout are made, then to build the index.
+template <class bwt_t, class P>
+void build(char const* out_file, P pass, uint32_t n_queries, int terminator, uint64_t isa_step,
+           uint16_t kmer_k) {
+    bbwt::symbol_counts counts;
+    pass([&](uint8_t head, uint32_t length) { counts.add(head, length); });
+    typename bwt_t::builder b(out_file, counts);
+    if (terminator >= 0) {
+        b.track_runs();
     }
+    pass([&](uint8_t head, uint32_t length) { b.append(head, length); });
     b.finalize();
+    if (terminator >= 0) {
+        bwt_t bwt(out_file);
+        bbwt::locator<bwt_t>::build(bwt, b.runs(), terminator, out_file);
+        if (isa_step) {
+            bbwt::extractor<bwt_t>::build(bwt, terminator, isa_step, out_file);
+        }
+    }
+    if (kmer_k) {
+        bwt_t bwt(out_file);
+        bbwt::kmer_table kmers = bbwt::kmer_table::build(bwt, kmer_k);
+        kmers.save(out_file);
+        std::cerr << "Stored " << kmer_k << "-mer ranges in " << kmers.bytes() << " bytes ("
+                  << (kmers.direct() ? "direct" : "hashed") << ")" << std::endl;
+    }
     //std::cerr << "a_blocks: " << bbwt::a_blocks
     //          << ", b_blocks: " << bbwt::b_blocks << std::endl;
     if (n_queries) {
@@ -91,6 +89,9 @@ int main(int argc, char const* argv[]) {
     bool small = false;
     bool const_runs = false;
     uint32_t n_queries = 0;
+    int terminator = -1;
+    uint64_t isa_step = 0;
+    uint16_t kmer_k = 0;
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-i") == 0) {
             in_file_loc = ++i;
@@ -104,6 +105,12 @@ int main(int argc, char const* argv[]) {
             small = true;
         } else if (strcmp(argv[i], "-q") == 0) {
             std::sscanf(argv[++i], "%u", &n_queries);
+        } else if (strcmp(argv[i], "-l") == 0) {
+            terminator = uint8_t(argv[++i][0]);
+        } else if (strcmp(argv[i], "-x") == 0) {
+            std::sscanf(argv[++i], "%lu", &isa_step);
+        } else if (strcmp(argv[i], "-k") == 0) {
+            std::sscanf(argv[++i], "%hu", &kmer_k);
         } else if (strcmp(argv[i], "-c") == 0) {
             const_runs = true;
         } else {
@@ -113,12 +120,53 @@ int main(int argc, char const* argv[]) {
     if (out_file_loc == 0) {
         std::cerr << "output file is required" << std::endl;
     }
-    if (const_runs) {
-        build<bwt_type_r>(argv, in_file_loc, heads_loc, runs_loc, out_file_loc, strip_new_line, n_queries);
-    } else if (small) {
-        build<bwt_type_b>(argv, in_file_loc, heads_loc, runs_loc, out_file_loc, strip_new_line, n_queries);
+    if (isa_step && terminator < 0) {
+        std::cerr << "extract support needs the text terminator given with -l" << std::endl;
+        exit(1);
+    }
+    auto build_from = [&](auto pass) {
+        if (const_runs) {
+            build<bwt_type_r>(argv[out_file_loc], pass, n_queries, terminator, isa_step, kmer_k);
+        } else if (small) {
+            build<bwt_type_b>(argv[out_file_loc], pass, n_queries, terminator, isa_step, kmer_k);
+        } else {
+            build<bwt_type_a>(argv[out_file_loc], pass, n_queries, terminator, isa_step, kmer_k);
+        }
+    };
+    auto text_pass = [&](const uint8_t* data, uint64_t size) {
+        return [=](auto f) {
+            bbwt::for_each_run(data, size, [&](uint8_t head, uint32_t length) {
+                if (!strip_new_line || head != '\n') {
+                    f(head, length);
+                }
+            });
+        };
+    };
+    if (in_file_loc) {
+        bbwt::mapped_file in(argv[in_file_loc], 0, MADV_SEQUENTIAL);
+        build_from(text_pass(in.data(), in.size()));
+    } else if (runs_loc || heads_loc) {
+        if (runs_loc == 0 || heads_loc == 0) {
+            std::cerr << "Both heads and run lengths are required" << std::endl;
+            help();
+        }
+        build_from([&](auto f) {
+            std::ifstream heads;
+            std::ifstream runs;
+            heads.open(argv[heads_loc], std::ios_base::in | std::ios_base::binary);
+            runs.open(argv[runs_loc], std::ios_base::in | std::ios_base::binary);
+            bbwt::multi_reader<bbwt::byte_alphabet<uint32_t>> reader(&heads, &runs);
+            for (auto it : reader) {
+                if (strip_new_line && (it.head == '\n')) {
+                    continue;
+                }
+                f(it.head, it.length);
+            }
+        });
     } else {
-        build<bwt_type_a>(argv, in_file_loc, heads_loc, runs_loc, out_file_loc, strip_new_line, n_queries);
+        std::vector<uint8_t> text((std::istreambuf_iterator<char>(std::cin)),
+                                  std::istreambuf_iterator<char>());
+        build_from(text_pass(text.data(), text.size()));
     }
     return 0;
 }
\ No newline at end of file
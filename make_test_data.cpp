@@ -43,9 +43,9 @@ int main(int argc, char const* argv[]) {
     for (size_t i = 0; i < n; i++) {
         uint64_t idx = gen(mt);
         for (size_t p_idx = p_len - 1; p_idx < p_len; p_idx--) {
-            chars[p_idx] = bwt[idx];
-            idx = bwt.LF(idx);
-            
+            auto r = bwt.inverse_select(idx);
+            chars[p_idx] = r.first;
+            idx = bwt.C(r.first) + r.second;
         }
         std::cout << chars << std::endl;
         std::cerr << "\r" << i + 1 << " patterns created";
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "include/matching_statistics.hpp"
+#include "include/open_index.hpp"
+
+void help() {
+    std::cout << "Stream a long query through an index for matching statistics and MEMs.\n\n";
+    std::cout << "Usage: matching_stats [options] <bwt_file> <query>\n";
+    std::cout << "   bwt_file     Index built with make_bwt -l c -x step.\n";
+    std::cout << "   query        File containing the query.\n";
+    std::cout << "   -L len       Output MEMs of at least len symbols. (default 20)\n";
+    std::cout << "   -T threads   Walk query chunks with threads threads. (default 1)\n";
+    std::cout << "   -s           Output the matching statistics instead of MEMs.\n";
+    std::cout << "   -n           Strip new line characters from the query.\n\n";
+    std::cout << "MEMs are written to std::cout as position, length and number of\n"
+              << "occurrences, and throughput to std::cerr.\n\n";
+    std::cout << "Example: matching_stats -L 30 -T 8 bwt.rlbwt genome.txt" << std::endl;
+    exit(0);
+}
+
+int main(int argc, char const* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Index and query files are required\n" << std::endl;
+        help();
+    }
+    std::string in_file_path = "";
+    std::string query_path = "";
+    uint64_t min_len = 20;
+    uint32_t threads = 1;
+    bool stats = false;
+    bool strip_new_line = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-L") == 0) {
+            std::sscanf(argv[++i], "%lu", &min_len);
+        } else if (strcmp(argv[i], "-T") == 0) {
+            std::sscanf(argv[++i], "%u", &threads);
+        } else if (strcmp(argv[i], "-s") == 0) {
+            stats = true;
+        } else if (strcmp(argv[i], "-n") == 0) {
+            strip_new_line = true;
+        } else if (in_file_path.size() == 0) {
+            in_file_path = argv[i];
+        } else {
+            query_path = argv[i];
+        }
+    }
+    std::ifstream in(query_path, std::ios::binary);
+    std::string query((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (strip_new_line) {
+        query.erase(std::remove(query.begin(), query.end(), '\n'), query.end());
+    }
+
+    using std::chrono::duration_cast;
+    using std::chrono::high_resolution_clock;
+    using std::chrono::nanoseconds;
+    bbwt::open_index(in_file_path).visit([&](const auto& bwt) {
+        typedef std::remove_cvref_t<decltype(bwt)> bwt_type;
+        bbwt::locator<bwt_type> loc(bwt, in_file_path);
+        bbwt::extractor<bwt_type> ext(bwt, in_file_path);
+        bbwt::matching_statistics<bwt_type> engine(bwt, loc, ext);
+        auto start = high_resolution_clock::now();
+        if (stats) {
+            std::vector<uint64_t> ms(query.size());
+            engine.compute(query, ms.data(), threads);
+            auto end = high_resolution_clock::now();
+            for (uint64_t v : ms) {
+                std::cout << v << "\n";
+            }
+            double secs = duration_cast<nanoseconds>(end - start).count() / 1e9;
+            std::cerr << "Matching statistics of " << query.size() << " bases in " << secs << "s: "
+                      << query.size() / secs << " bases/s" << std::endl;
+            return 0;
+        }
+        std::vector<bbwt::mem> mems = engine.mems(query, min_len, threads);
+        auto end = high_resolution_clock::now();
+        for (const auto& m : mems) {
+            std::cout << m.pos << "\t" << m.len << "\t" << m.count << "\n";
+        }
+        double secs = duration_cast<nanoseconds>(end - start).count() / 1e9;
+        std::cerr << mems.size() << " MEMs of at least " << min_len << " symbols in " << query.size()
+                  << " bases in " << secs << "s: " << query.size() / secs << " bases/s" << std::endl;
+        return 0;
+    });
+}
@@ -7,6 +7,7 @@
 #include <cassert>
 #include <fstream>
 
+#include "include/byte_alphabet.hpp"
 #include "include/reader.hpp"
 #include "include/types.hpp"
 
@@ -23,7 +24,7 @@ int main(int argc, char const* argv[]) {
     std::ifstream runs;
     heads.open(heads_path, std::ios_base::in | std::ios_base::binary);
     runs.open(lens_path, std::ios_base::in | std::ios_base::binary);
-    bbwt::multi_reader<bbwt::custom_alphabet<uint64_t>> reader(&heads, &runs);
+    bbwt::multi_reader<bbwt::byte_alphabet<uint32_t>> reader(&heads, &runs);
 
     uint64_t res = 0;
     uint64_t consumed_runs = 0;